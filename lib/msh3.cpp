@@ -290,6 +290,39 @@ MsH3ConnectionGetQuicParam(
     return MsQuic->GetParam(((MsH3pConnection*)Handle)->Handle, Param, BufferLength, Buffer);
 }
 
+extern "C"
+MSH3_STATUS
+MSH3_CALL
+MsH3ConnectionGetParam(
+    MSH3_CONNECTION* Handle,
+    MSH3_CONNECTION_PARAM Param,
+    uint32_t* BufferLength,
+    void* Buffer
+    )
+{
+    if (!Handle || !BufferLength) {
+        return MSH3_STATUS_INVALID_STATE;
+    }
+    auto H3 = (MsH3pConnection*)Handle;
+    switch (Param) {
+    case MSH3_PARAM_CONNECTION_POOL_STATISTICS: {
+        if (*BufferLength < sizeof(MSH3_CONNECTION_POOL_STATISTICS) || !Buffer) {
+            *BufferLength = sizeof(MSH3_CONNECTION_POOL_STATISTICS);
+            return MSH3_STATUS_INVALID_STATE;
+        }
+        auto Stats = (MSH3_CONNECTION_POOL_STATISTICS*)Buffer;
+        H3->AppSendPool.GetStatistics(&Stats->AppSend);
+        H3->SendBufferPool.GetStatistics(&Stats->SendBuffer);
+        H3->EncodeBufferPool.GetStatistics(&Stats->EncodeBuffer);
+        H3->DecodeBufferPool.GetStatistics(&Stats->DecodeBuffer);
+        *BufferLength = sizeof(MSH3_CONNECTION_POOL_STATISTICS);
+        return MSH3_STATUS_SUCCESS;
+    }
+    default:
+        return MSH3_STATUS_INVALID_STATE;
+    }
+}
+
 extern "C"
 MSH3_REQUEST*
 MSH3_CALL
@@ -345,6 +378,54 @@ MsH3RequestCompleteReceive(
     ((MsH3pBiDirStream*)Handle)->CompleteReceive(Length);
 }
 
+extern "C"
+uint64_t
+MSH3_CALL
+MsH3RequestRetainReceive(
+    MSH3_REQUEST* Handle
+    )
+{
+    return ((MsH3pBiDirStream*)Handle)->RetainReceive();
+}
+
+extern "C"
+void
+MSH3_CALL
+MsH3RequestReleaseReceive(
+    MSH3_REQUEST* Handle,
+    uint64_t RetainId
+    )
+{
+    ((MsH3pBiDirStream*)Handle)->ReleaseReceive(RetainId);
+}
+
+extern "C"
+bool
+MSH3_CALL
+MsH3RequestGetPseudoHeaders(
+    MSH3_REQUEST* Handle,
+    MSH3_PSEUDO_HEADERS* PseudoHeaders
+    )
+{
+    auto Stream = (MsH3pBiDirStream*)Handle;
+    std::lock_guard Lock{Stream->ReceiveLock};
+    if (!Stream->HasPseudoHeaders) return false;
+    *PseudoHeaders = Stream->PseudoHeaders;
+    return true;
+}
+
+extern "C"
+bool
+MSH3_CALL
+MsH3RequestSetReceiveFile(
+    MSH3_REQUEST* Handle,
+    MSH3_FILE File,
+    uint64_t Offset
+    )
+{
+    return ((MsH3pBiDirStream*)Handle)->SetReceiveFile(File, Offset);
+}
+
 extern "C"
 void
 MSH3_CALL
@@ -369,7 +450,116 @@ MsH3RequestSend(
     void* AppContext
     )
 {
-    return ((MsH3pBiDirStream*)Handle)->Send(Flags, Headers, HeadersCount, Data, DataLength, AppContext);
+    const MSH3_BUFFER Buffer = { DataLength, (const uint8_t*)Data };
+    return ((MsH3pBiDirStream*)Handle)->Send(Flags, Headers, HeadersCount, &Buffer, Data ? 1 : 0, AppContext, nullptr, MsH3pSendApp);
+}
+
+extern "C"
+bool
+MSH3_CALL
+MsH3RequestSendV(
+    MSH3_REQUEST* Handle,
+    MSH3_REQUEST_SEND_FLAGS Flags,
+    const MSH3_HEADER* Headers,
+    size_t HeadersCount,
+    const MSH3_BUFFER* Buffers,
+    uint32_t BufferCount,
+    void* AppContext
+    )
+{
+    if (BufferCount != 0 && Buffers == nullptr) return false;
+    return ((MsH3pBiDirStream*)Handle)->Send(Flags, Headers, HeadersCount, Buffers, BufferCount, AppContext, nullptr, MsH3pSendApp);
+}
+
+extern "C"
+bool
+MSH3_CALL
+MsH3RequestSendShared(
+    MSH3_REQUEST* Handle,
+    MSH3_REQUEST_SEND_FLAGS Flags,
+    const MSH3_HEADER* Headers,
+    size_t HeadersCount,
+    MSH3_SHARED_BUFFER* SharedBuffer,
+    void* AppContext
+    )
+{
+    auto Shared = (MsH3pSharedBuffer*)SharedBuffer;
+    if (!Shared) return false;
+    const MSH3_BUFFER Buffer = { Shared->Length, Shared->Buffer };
+    return ((MsH3pBiDirStream*)Handle)->Send(Flags, Headers, HeadersCount, &Buffer, 1, AppContext, Shared, MsH3pSendApp);
+}
+
+extern "C"
+uint32_t
+MSH3_CALL
+MsH3RequestSubmitBatch(
+    MSH3_CONNECTION* Handle,
+    MSH3_REQUEST_SUBMISSION* Submissions,
+    uint32_t SubmissionCount
+    )
+{
+    if (!Handle || (SubmissionCount != 0 && !Submissions)) return 0;
+    return ((MsH3pConnection*)Handle)->SubmitRequests(Submissions, SubmissionCount);
+}
+
+extern "C"
+bool
+MSH3_CALL
+MsH3RequestSendTemplate(
+    MSH3_REQUEST* Handle,
+    MSH3_REQUEST_SEND_FLAGS Flags,
+    MSH3_HEADER_TEMPLATE* Template,
+    const MSH3_BUFFER* SlotValues,
+    uint32_t SlotValueCount,
+    const void* Data,
+    uint32_t DataLength,
+    void* AppContext
+    )
+{
+    if (!Template || (SlotValueCount != 0 && SlotValues == nullptr)) return false;
+    const MSH3_BUFFER Buffer = { DataLength, (const uint8_t*)Data };
+    return
+        ((MsH3pBiDirStream*)Handle)->SendTemplate(
+            Flags, (MsH3pHeaderTemplate*)Template, SlotValues, SlotValueCount,
+            &Buffer, Data ? 1 : 0, AppContext);
+}
+
+extern "C"
+bool
+MSH3_CALL
+MsH3RequestFlush(
+    MSH3_REQUEST* Handle
+    )
+{
+    return ((MsH3pBiDirStream*)Handle)->Flush();
+}
+
+extern "C"
+bool
+MSH3_CALL
+MsH3RequestSendFile(
+    MSH3_REQUEST* Handle,
+    MSH3_REQUEST_SEND_FLAGS Flags,
+    const MSH3_HEADER* Headers,
+    size_t HeadersCount,
+    MSH3_FILE File,
+    uint64_t Offset,
+    uint64_t Length,
+    void* AppContext
+    )
+{
+    return ((MsH3pBiDirStream*)Handle)->SendFile(Flags, Headers, HeadersCount, File, Offset, Length, AppContext);
+}
+
+extern "C"
+bool
+MSH3_CALL
+MsH3RequestSetSendBodyLength(
+    MSH3_REQUEST* Handle,
+    uint64_t Length
+    )
+{
+    return ((MsH3pBiDirStream*)Handle)->SetSendBodyLength(Length);
 }
 
 extern "C"
@@ -396,6 +586,61 @@ MsH3RequestSetCallbackHandler(
     ((MsH3pBiDirStream*)Handle)->SetCallbackHandler(Handler, Context);
 }
 
+extern "C"
+MSH3_HEADER_TEMPLATE*
+MSH3_CALL
+MsH3HeaderTemplateOpen(
+    const MSH3_HEADER* Headers,
+    size_t HeadersCount
+    )
+{
+    if (!Headers) return nullptr;
+    auto Template = new(std::nothrow) MsH3pHeaderTemplate();
+    if (!Template || !Template->Initialize(Headers, HeadersCount)) {
+        delete Template;
+        return nullptr;
+    }
+    return (MSH3_HEADER_TEMPLATE*)Template;
+}
+
+extern "C"
+void
+MSH3_CALL
+MsH3HeaderTemplateClose(
+    MSH3_HEADER_TEMPLATE* Handle
+    )
+{
+    ((MsH3pHeaderTemplate*)Handle)->Release();
+}
+
+extern "C"
+MSH3_SHARED_BUFFER*
+MSH3_CALL
+MsH3SharedBufferOpen(
+    const void* Data,
+    uint32_t Length
+    )
+{
+    if (!Data || Length == 0) return nullptr;
+    auto SharedBuffer = new(std::nothrow) MsH3pSharedBuffer(Length);
+    if (!SharedBuffer || !SharedBuffer->Buffer) {
+        delete SharedBuffer;
+        return nullptr;
+    }
+    memcpy(SharedBuffer->Buffer, Data, Length);
+    return (MSH3_SHARED_BUFFER*)SharedBuffer;
+}
+
+extern "C"
+void
+MSH3_CALL
+MsH3SharedBufferClose(
+    MSH3_SHARED_BUFFER* Handle
+    )
+{
+    ((MsH3pSharedBuffer*)Handle)->Release();
+}
+
 extern "C"
 MSH3_LISTENER*
 MSH3_CALL
@@ -431,6 +676,7 @@ MsH3ListenerClose(
 
 struct MsH3pSettings : public MsQuicSettings {
     MsQuicSettings& SetKeepAliveIntervalMs(uint32_t Value) { KeepAliveIntervalMs = Value; IsSet.KeepAliveIntervalMs = TRUE; return *this; }
+    MsQuicSettings& SetStreamMultiReceiveEnabled(bool Value) { StreamMultiReceiveEnabled = Value; IsSet.StreamMultiReceiveEnabled = TRUE; return *this; }
     MsH3pSettings(
         const MSH3_SETTINGS* Settings,
         uint32_t SettingsLength
@@ -463,6 +709,9 @@ struct MsH3pSettings : public MsQuicSettings {
             if (Settings->IsSet.XdpEnabled) {
                 SetXdpEnabled(Settings->XdpEnabled);
             }
+            if (Settings->IsSet.ReceiveRetainEnabled && Settings->ReceiveRetainEnabled) {
+                SetStreamMultiReceiveEnabled(true); // Retained data is completed out of band
+            }
         }
     }
 };
@@ -483,6 +732,35 @@ MsH3pConfiguration::MsH3pConfiguration(
         if (Settings->IsSet.DynamicQPackEnabled) {
             DynamicQPackEnabled = Settings->DynamicQPackEnabled;
         }
+        if (Settings->IsSet.SendCompleteBatchEnabled) {
+            SendCompleteBatchEnabled = Settings->SendCompleteBatchEnabled;
+        }
+        if (Settings->IsSet.ReceiveVectoredEnabled) {
+            ReceiveVectoredEnabled = Settings->ReceiveVectoredEnabled;
+        }
+        if (Settings->IsSet.ReceiveRetainEnabled) {
+            ReceiveRetainEnabled = Settings->ReceiveRetainEnabled;
+        }
+        if (Settings->IsSet.HeadersCompleteEnabled) {
+            HeadersCompleteEnabled = Settings->HeadersCompleteEnabled;
+        }
+        if (Settings->IsSet.ContentLengthEnabled) {
+            ContentLengthEnabled = Settings->ContentLengthEnabled;
+        }
+        if (Settings->IsSet.SendWatermarks &&
+            SettingsLength >= offsetof(MSH3_SETTINGS, SendLowWatermarkPercent) + sizeof(uint16_t)) {
+            SendHighWatermarkPercent = Settings->SendHighWatermarkPercent ? Settings->SendHighWatermarkPercent : 1;
+            SendLowWatermarkPercent = min(Settings->SendLowWatermarkPercent, SendHighWatermarkPercent);
+        }
+        if (Settings->IsSet.MaxFieldSectionSize &&
+            SettingsLength >= offsetof(MSH3_SETTINGS, MaxFieldSectionSize) + sizeof(uint32_t) &&
+            Settings->MaxFieldSectionSize != 0) {
+            MaxFieldSectionSize = Settings->MaxFieldSectionSize;
+        }
+        if (Settings->IsSet.SendBufferingThreshold &&
+            SettingsLength >= offsetof(MSH3_SETTINGS, SendBufferingThreshold) + sizeof(uint32_t)) {
+            SendBufferingThreshold = min(Settings->SendBufferingThreshold, (uint32_t)MSH3_SEND_BUFFER_SIZE);
+        }
     }
 }
 
@@ -592,6 +870,15 @@ MsH3pConnection::InitializeConfig(
     )
 {
     DynamicQPackEnabled = Configuration.DynamicQPackEnabled;
+    SendBufferingThreshold = Configuration.SendBufferingThreshold;
+    SendCompleteBatchEnabled = Configuration.SendCompleteBatchEnabled;
+    ReceiveVectoredEnabled = Configuration.ReceiveVectoredEnabled;
+    ReceiveRetainEnabled = Configuration.ReceiveRetainEnabled;
+    HeadersCompleteEnabled = Configuration.HeadersCompleteEnabled;
+    ContentLengthEnabled = Configuration.ContentLengthEnabled;
+    MaxFieldSectionSize = Configuration.MaxFieldSectionSize;
+    SendHighWatermarkPercent = Configuration.SendHighWatermarkPercent;
+    SendLowWatermarkPercent = Configuration.SendLowWatermarkPercent;
     LocalControl = new(std::nothrow) MsH3pUniDirStream(*this, Configuration);
     if (QUIC_FAILED(LocalControl->GetInitStatus())) return LocalControl->GetInitStatus();
     return QUIC_STATUS_SUCCESS;
@@ -681,11 +968,12 @@ MsH3pConnection::ReceiveSettingsFrame(
 {
     uint32_t Offset = 0;
 
-    do {
+    while (Offset < BufferLength) { // May be empty
         QUIC_VAR_INT SettingType, SettingValue;
         if (!MsH3pVarIntDecode(BufferLength, Buffer, &Offset, &SettingType) ||
             !MsH3pVarIntDecode(BufferLength, Buffer, &Offset, &SettingValue)) {
             printf("Not enough settings.\n");
+            Shutdown(H3ErrorFrameError);
             return false;
         }
 
@@ -711,8 +999,7 @@ MsH3pConnection::ReceiveSettingsFrame(
             //printf("Unknown/unsupported setting type: 0x%llx\n", (unsigned long long)SettingType);
             break;
         }
-
-    } while (Offset < BufferLength);
+    }
 
     tsu_buf_sz = sizeof(tsu_buf);
 
@@ -723,19 +1010,97 @@ MsH3pConnection::ReceiveSettingsFrame(
     //       dynamicTableSize, blockedStreams, DynamicQPackEnabled ? "true" : "false", PeerMaxTableSize, PeerQPackBlockedStreams);
 
     // Initialize the encoder
-    if (lsqpack_enc_init(&Encoder, MSH3_QPACK_LOG_CONTEXT, dynamicTableSize, dynamicTableSize, (unsigned)blockedStreams, LSQPACK_ENC_OPT_STAGE_2, tsu_buf, &tsu_buf_sz) != 0) {
-        printf("lsqpack_enc_init failed\n");
-        return false;
+    {
+        std::lock_guard Lock{EncoderLock};
+        if (lsqpack_enc_init(&Encoder, MSH3_QPACK_LOG_CONTEXT, dynamicTableSize, dynamicTableSize, (unsigned)blockedStreams, LSQPACK_ENC_OPT_STAGE_2, tsu_buf, &tsu_buf_sz) != 0) {
+            printf("lsqpack_enc_init failed\n");
+            Shutdown(H3ErrorInternalError);
+            return false;
+        }
     }
 
     // Re-initialize the decoder to match the encoder settings
     // This ensures encoder/decoder compatibility regardless of peer capabilities
+    std::lock_guard Lock{DecoderLock}; // Not nested in EncoderLock, which header callbacks may take
     lsqpack_dec_cleanup(&Decoder);
     lsqpack_dec_init(&Decoder, MSH3_QPACK_LOG_CONTEXT, dynamicTableSize, (unsigned)blockedStreams, &MsH3pBiDirStream::hset_if, (lsqpack_dec_opts)0);
 
     return true;
 }
 
+uint32_t
+MsH3pConnection::SubmitRequests(
+    _Inout_updates_(SubmissionCount)
+        MSH3_REQUEST_SUBMISSION* Submissions,
+    _In_ uint32_t SubmissionCount
+    )
+{
+    //
+    // Open all the requests first, so each has its stream ID for encoding.
+    //
+    size_t EncoderBound = 0;
+    for (uint32_t i = 0; i < SubmissionCount; ++i) {
+        auto& Submission = Submissions[i];
+        Submission.Request = nullptr;
+        if (!Submission.Headers || Submission.HeadersCount == 0 ||
+            (Submission.DataLength != 0 && !Submission.Data)) {
+            continue;
+        }
+        auto Request = new(std::nothrow) MsH3pBiDirStream(*this, Submission.Handler, Submission.Context, Submission.Flags);
+        if (!Request || !Request->IsValid()) {
+            delete Request;
+            continue;
+        }
+        Submission.Request = (MSH3_REQUEST*)Request;
+        EncoderBound += H3EncodedHeadersBound(Submission.Headers, Submission.HeadersCount);
+    }
+
+    //
+    // Encode all the header blocks back to back, with any resulting encoder
+    // instructions going out in a single send on the encoder stream.
+    //
+    {
+        std::lock_guard Lock{EncoderLock};
+        auto EncoderOutput = MsH3pEncodeBuffer::Alloc(EncodeBufferPool, EncoderBound);
+        for (uint32_t i = 0; i < SubmissionCount; ++i) {
+            auto Request = (MsH3pBiDirStream*)Submissions[i].Request;
+            if (!Request) continue;
+            Request->Buffers[1].Buffer = Request->PrefixBuffer;
+            if (!EncoderOutput ||
+                !LocalEncoder->EncodeHeaderBlock(Request, Submissions[i].Headers, Submissions[i].HeadersCount, EncoderOutput)) {
+                delete Request;
+                Submissions[i].Request = nullptr;
+            }
+        }
+        if (EncoderOutput) LocalEncoder->SendEncoderOutput(EncoderOutput);
+    }
+
+    //
+    // Queue the frames for all but the last request with DELAY_SEND, so
+    // MsQuic packs them densely when the last one flushes the connection. If
+    // that last send fails, the others stay queued until the connection's
+    // next send that isn't delayed (see MsH3RequestSubmitBatch).
+    //
+    uint32_t LastIndex = SubmissionCount;
+    while (LastIndex != 0 && !Submissions[LastIndex - 1].Request) --LastIndex;
+    uint32_t SubmittedCount = 0;
+    for (uint32_t i = 0; i < SubmissionCount; ++i) {
+        auto& Submission = Submissions[i];
+        auto Request = (MsH3pBiDirStream*)Submission.Request;
+        if (!Request) continue;
+        auto Flags = Submission.SendFlags;
+        if (i + 1 != LastIndex) Flags |= MSH3_REQUEST_SEND_FLAG_DELAY_SEND;
+        const MSH3_BUFFER Data = { Submission.DataLength, (const uint8_t*)Submission.Data };
+        if (!Request->SendEncoded(Flags, &Data, Submission.DataLength ? 1 : 0, Submission.AppContext)) {
+            delete Request;
+            Submission.Request = nullptr;
+            continue;
+        }
+        SubmittedCount++;
+    }
+    return SubmittedCount;
+}
+
 //
 // MsH3pUniDirStream
 //
@@ -757,9 +1122,10 @@ MsH3pUniDirStream::MsH3pUniDirStream(MsH3pConnection& Connection, const MsH3pCon
     Buffer.Buffer[0] = (uint8_t)Type;
     Buffer.Length = 1;
 
-    H3Settings Settings[3];
+    H3Settings Settings[4];
     uint32_t SettingsLength = 0;
     Settings[SettingsLength++] = { H3SettingQPackMaxTableCapacity, GetQPackMaxTableCapacity(Configuration.DynamicQPackEnabled) };
+    Settings[SettingsLength++] = { H3SettingMaxFieldSectionSize, Configuration.MaxFieldSectionSize };
     Settings[SettingsLength++] = { H3SettingQPackBlockedStreams, GetQPackBlockedStreams(Configuration.DynamicQPackEnabled) };
     if (Configuration.DatagramEnabled) {
         Settings[SettingsLength++] = { H3SettingDatagrams, 1 };
@@ -802,30 +1168,35 @@ MsH3pUniDirStream::ControlReceive(
     _In_ const QUIC_BUFFER* RecvBuffer
     )
 {
-    uint32_t Offset = 0;
-
     DebugIoBuffer(RecvBuffer, "recv", Type);
 
-    do {
-        QUIC_VAR_INT FrameType, FrameLength;
-        if (!MsH3pVarIntDecode(RecvBuffer->Length, RecvBuffer->Buffer, &Offset, &FrameType) ||
-            !MsH3pVarIntDecode(RecvBuffer->Length, RecvBuffer->Buffer, &Offset, &FrameLength)) {
-            printf("Not enough control data yet for frame headers.\n");
-            return; // TODO - Implement local buffering
+    //
+    // Frames may be split anywhere across buffers and receive events, so the
+    // reader keeps any partial frame until the rest arrives.
+    //
+    if (FrameReader.Failed) return; // The connection is closing already
+    const uint8_t* Data = RecvBuffer->Buffer;
+    uint32_t Length = RecvBuffer->Length;
+    while (Length != 0) {
+        uint32_t Consumed;
+        auto Result = FrameReader.Read(Data, Length, &Consumed);
+        Data += Consumed;
+        Length -= Consumed;
+        if (Result == H3FrameReadNeedMore) return;
+        if (Result != H3FrameReadComplete) {
+            printf("Control frame too big, or out of memory.\n");
+            H3.Shutdown(
+                Result == H3FrameReadError ? H3ErrorExcessiveLoad : H3ErrorInternalError);
+            return;
         }
 
-        if (FrameType != H3FrameData && Offset + (uint32_t)FrameLength > RecvBuffer->Length) {
-            printf("Not enough control data yet for frame payload.\n");
-            return; // TODO - Implement local buffering
-        }
-
-        if (FrameType == H3FrameSettings) {
-            if (!H3.ReceiveSettingsFrame((uint32_t)FrameLength, RecvBuffer->Buffer + Offset)) return;
+        if (FrameReader.Type == H3FrameSettings) {
+            if (!H3.ReceiveSettingsFrame(FrameReader.PayloadLength, FrameReader.Payload)) {
+                FrameReader.Failed = true; // The connection was closed
+                return;
+            }
         }
-
-        Offset += (uint32_t)FrameLength;
-
-    } while (Offset < RecvBuffer->Length);
+    }
 }
 
 bool
@@ -835,6 +1206,32 @@ MsH3pUniDirStream::EncodeHeaders(
         const MSH3_HEADER* Headers,
     _In_ size_t HeadersCount
     )
+{
+    //
+    // Requests on the same connection may be sent from any number of app
+    // threads. The encoder, and the order its instructions go out on the
+    // encoder stream, are shared by all of them.
+    //
+    std::lock_guard Lock{H3.EncoderLock};
+    auto EncoderOutput =
+        MsH3pEncodeBuffer::Alloc(H3.EncodeBufferPool, H3EncodedHeadersBound(Headers, HeadersCount));
+    if (!EncoderOutput) {
+        printf("Encoder buffer allocation failed\n");
+        return false;
+    }
+    auto Result = EncodeHeaderBlock(Request, Headers, HeadersCount, EncoderOutput);
+    SendEncoderOutput(EncoderOutput);
+    return Result;
+}
+
+bool
+MsH3pUniDirStream::EncodeHeaderBlock(
+    _In_ MsH3pBiDirStream* Request,
+    _In_reads_(HeadersCount)
+        const MSH3_HEADER* Headers,
+    _In_ size_t HeadersCount,
+    _Inout_ MsH3pEncodeBuffer* EncoderOutput
+    )
 {
     auto StreamId = Request->ID();
     if (StreamId > QUIC_UINT62_MAX) {
@@ -846,45 +1243,98 @@ MsH3pUniDirStream::EncodeHeaders(
         return false;
     }
 
-    size_t enc_off = 0, hea_off = 0;
+    //
+    // Both the header block and the encoder instructions are bounded by the
+    // literal size of the headers, so the caller sizes the encoder output for
+    // that up front. The common small case uses the request's inline buffer.
+    //
+    const size_t Bound = H3EncodedHeadersBound(Headers, HeadersCount);
+    uint8_t* HeadersBuffer = Request->ReserveHeadersBuffer(Bound);
+
+    //
+    // lsxpack needs each name and value to be contiguous. Headers laid out
+    // that way by the app are encoded in place, and the rest are staged one
+    // at a time in a scratch buffer big enough for the largest of them.
+    //
+    size_t ScratchLength = 0;
     for (size_t i = 0; i < HeadersCount; ++i) {
-        H3HeadingPair Header;
-        if (!Header.Set(Headers+i)) {
-            printf("Header.Set failed\n");
-            return false;
+        if (Headers[i].Value != Headers[i].Name + Headers[i].NameLength &&
+            Headers[i].NameLength + Headers[i].ValueLength > ScratchLength) {
+            ScratchLength = Headers[i].NameLength + Headers[i].ValueLength;
+        }
+    }
+    char StackScratch[256];
+    char* HeapScratch = ScratchLength > sizeof(StackScratch) ? new(std::nothrow) char[ScratchLength] : nullptr;
+    char* Scratch = ScratchLength > sizeof(StackScratch) ? HeapScratch : StackScratch;
+
+    bool Result = false;
+    size_t hea_off = 0;
+    enum lsqpack_enc_header_flags hflags;
+    ssize_t pref_sz;
+    if (!HeadersBuffer || !Scratch) {
+        printf("Header buffer allocation failed\n");
+        goto Error;
+    }
+
+    for (size_t i = 0; i < HeadersCount; ++i) {
+        if (H3.ContentLengthEnabled && MsH3pIsMethodHeader(Headers[i])) {
+            Request->SentHeadRequest =
+                MsH3pParseMethod(Headers[i].Value, Headers[i].ValueLength) == MSH3_METHOD_HEAD;
+        }
+        lsxpack_header_t Header;
+        if (!H3SetEncodeField(&Header, Headers+i, Scratch)) {
+            printf("Header too large\n");
+            goto Error;
         }
-        size_t enc_size = sizeof(RawBuffer) - enc_off, hea_size = sizeof(Request->HeadersBuffer) - hea_off;
+        auto& enc_off = EncoderOutput->Buffer.Length;
+        size_t enc_size = EncoderOutput->Capacity - enc_off, hea_size = Bound - hea_off;
 
         // Use dynamic table if possible - don't set LQEF_NO_INDEX or LQEF_NEVER_INDEX flags
         // This allows the encoder to decide whether to index the header
-        auto result = lsqpack_enc_encode(&H3.Encoder, RawBuffer + enc_off, &enc_size, Request->HeadersBuffer + hea_off, &hea_size, &Header, (lsqpack_enc_flags)0);
+        auto result = lsqpack_enc_encode(&H3.Encoder, EncoderOutput->Data() + enc_off, &enc_size, HeadersBuffer + hea_off, &hea_size, &Header, (lsqpack_enc_flags)0);
         if (result != LQES_OK) {
             printf("lsqpack_enc_encode failed, %d\n", result);
-            return false;
+            goto Error;
         }
-        enc_off += enc_size;
+        enc_off += (uint32_t)enc_size; // Kept even on later failure, as the table was updated
         hea_off += hea_size;
     }
-    Buffer.Length = (uint32_t)enc_off;
     Request->Buffers[2].Length = (uint32_t)hea_off;
 
-    enum lsqpack_enc_header_flags hflags;
-    auto pref_sz = lsqpack_enc_end_header(&H3.Encoder, Request->PrefixBuffer, sizeof(Request->PrefixBuffer), &hflags);
+    pref_sz = lsqpack_enc_end_header(&H3.Encoder, Request->PrefixBuffer, sizeof(Request->PrefixBuffer), &hflags);
     if (pref_sz < 0) {
         printf("lsqpack_enc_end_header failed\n");
-        return false;
+        goto Exit;
     }
     Request->Buffers[1].Length = (uint32_t)pref_sz;
+    Result = true;
+    goto Exit;
+
+Error:
+    lsqpack_enc_cancel_header(&H3.Encoder);
+Exit:
+    delete [] HeapScratch;
+    return Result;
+}
 
-    // If there's encoder output from dynamic indexing, send it on the encoder stream
-    if (Buffer.Length != 0) {
-        DebugIoBuffer(&Buffer, "send", Type);
-        if (QUIC_FAILED(Send(&Buffer, 1, QUIC_SEND_FLAG_ALLOW_0_RTT))) {
+void
+MsH3pUniDirStream::SendEncoderOutput(
+    _In_ MsH3pEncodeBuffer* EncoderOutput
+    )
+{
+    //
+    // If there's encoder output from dynamic indexing, send it on the encoder
+    // stream. The buffer is owned by the send and freed on its completion.
+    //
+    if (EncoderOutput->Buffer.Length != 0) {
+        DebugIoBuffer(&EncoderOutput->Buffer, "send", Type);
+        if (QUIC_FAILED(Send(&EncoderOutput->Buffer, 1, QUIC_SEND_FLAG_ALLOW_0_RTT, EncoderOutput))) {
             printf("Encoder send failed\n");
+            MsH3pEncodeBuffer::Free(EncoderOutput);
         }
+    } else {
+        MsH3pEncodeBuffer::Free(EncoderOutput);
     }
-
-    return true;
 }
 
 void
@@ -892,6 +1342,8 @@ MsH3pUniDirStream::SendQPackAcknowledgment(
     _In_ uint64_t StreamId
     )
 {
+    std::lock_guard Lock{H3.DecoderLock}; // Also serializes use of Buffer
+
     // TODO: This function reuses the same Buffer and RawBuffer as other functions,
     // as well as duplicate calls of this function. It's possible they are still
     // being used by MsQuic. We need to dynamically allocate (from a pool?) these
@@ -926,6 +1378,7 @@ MsH3pUniDirStream::SendQPackAcknowledgment(
 void
 MsH3pUniDirStream::SendQPackStreamInstructions()
 {
+    std::lock_guard Lock{H3.DecoderLock};
     // Send any pending Insert Count Increment instructions
     if (lsqpack_dec_ici_pending(&H3.Decoder)) {
         Buffer.Length = (uint32_t)lsqpack_dec_write_ici(&H3.Decoder, RawBuffer, sizeof(RawBuffer));
@@ -943,6 +1396,7 @@ MsH3pUniDirStream::SendStreamCancellation(
     _In_ uint64_t StreamId
     )
 {
+    std::lock_guard Lock{H3.DecoderLock};
     Buffer.Length = (uint32_t)lsqpack_dec_cancel_stream_id(&H3.Decoder, StreamId, RawBuffer, sizeof(RawBuffer));
     if (Buffer.Length > 0) {
         auto Status = Send(&Buffer, 1, QUIC_SEND_FLAG_NONE);
@@ -968,6 +1422,7 @@ MsH3pUniDirStream::EncoderStreamCallback(
 
             if (Buffer->Length > 0) {
                 // Feed encoder instructions to the QPACK decoder
+                std::lock_guard Lock{H3.DecoderLock};
                 int ret = lsqpack_dec_enc_in(&H3.Decoder,
                                            Buffer->Buffer,
                                            Buffer->Length);
@@ -978,6 +1433,9 @@ MsH3pUniDirStream::EncoderStreamCallback(
             }
         }
         break;
+    case QUIC_STREAM_EVENT_SEND_COMPLETE:
+        MsH3pEncodeBuffer::Free((MsH3pEncodeBuffer*)Event->SEND_COMPLETE.ClientContext);
+        break;
     case QUIC_STREAM_EVENT_PEER_SEND_ABORTED:
         break;
     case QUIC_STREAM_EVENT_PEER_RECEIVE_ABORTED:
@@ -1001,6 +1459,7 @@ MsH3pUniDirStream::DecoderStreamCallback(
 
             if (Buffer->Length > 0) {
                 // Process decoder instructions from peer
+                std::lock_guard Lock{H3.EncoderLock};
                 int ret = lsqpack_enc_decoder_in(&H3.Encoder,
                                                 Buffer->Buffer,
                                                 Buffer->Length);
@@ -1026,12 +1485,24 @@ MsH3pUniDirStream::UnknownStreamCallback(
     )
 {
     switch (Event->Type) {
-    case QUIC_STREAM_EVENT_RECEIVE:
-        if (Event->RECEIVE.TotalBufferLength > 0) {
-            auto FirstBuffer = (QUIC_BUFFER*)Event->RECEIVE.Buffers;
-            auto NewType = FirstBuffer->Buffer[0];
-            FirstBuffer->Buffer++; FirstBuffer->Length--;
-            switch (NewType) {
+    case QUIC_STREAM_EVENT_RECEIVE: {
+        //
+        // The stream type is a varint, which may itself be split across
+        // buffers and receive events. The rest goes to the type's handler.
+        //
+        auto Buffers = (QUIC_BUFFER*)Event->RECEIVE.Buffers;
+        uint32_t i = 0;
+        for (; i < Event->RECEIVE.BufferCount; ++i) {
+            const uint8_t* Cur = Buffers[i].Buffer;
+            bool TypeComplete = StreamTypeReader.Feed(&Cur, Buffers[i].Buffer + Buffers[i].Length);
+            Buffers[i].Length -= (uint32_t)(Cur - Buffers[i].Buffer);
+            Buffers[i].Buffer = (uint8_t*)Cur;
+            if (TypeComplete) break;
+        }
+        if (i < Event->RECEIVE.BufferCount) { // Unknown types are ignored
+            Event->RECEIVE.Buffers = Buffers + i;
+            Event->RECEIVE.BufferCount -= i;
+            switch (StreamTypeReader.Value) {
             case H3StreamTypeControl:
                 Type = H3StreamTypeControl;
                 H3.PeerControl = this;
@@ -1052,6 +1523,7 @@ MsH3pUniDirStream::UnknownStreamCallback(
             }
         }
         break;
+    }
     case QUIC_STREAM_EVENT_PEER_SEND_ABORTED:
         break;
     case QUIC_STREAM_EVENT_PEER_RECEIVE_ABORTED:
@@ -1072,47 +1544,685 @@ MsH3pBiDirStream::hset_if = {
     .dhi_process_header = s_DecodeProcess,
 };
 
+bool
+MsH3pBiDirStream::ValidateSend(
+    _In_ MSH3_REQUEST_SEND_FLAGS Flags,
+    _In_ bool HasHeaders,
+    _In_reads_(DataBufferCount)
+        const MSH3_BUFFER* DataBuffers,
+    _In_ uint32_t DataBufferCount,
+    _Out_ uint64_t* DataLength
+    )
+{
+    *DataLength = 0;
+    for (uint32_t i = 0; i < DataBufferCount; ++i) {
+        *DataLength += DataBuffers[i].Length;
+    }
+    if (DeclaredDataLeft != 0) {
+        if (*DataLength > DeclaredDataLeft) return false; // More data than declared
+        if ((Flags & MSH3_REQUEST_SEND_FLAG_FIN) && *DataLength != DeclaredDataLeft) return false; // Less data than declared
+        if (HasHeaders && DeclaredFrameHeaderSent) return false; // Can't interrupt the DATA frame
+    }
+    return true;
+}
+
 bool
 MsH3pBiDirStream::Send(
     _In_ MSH3_REQUEST_SEND_FLAGS Flags,
     _In_reads_(HeadersCount)
         const MSH3_HEADER* Headers,
     _In_ size_t HeadersCount,
-    _In_reads_bytes_(DataLength) const void* Data,
-    _In_ uint32_t DataLength,
-    _In_opt_ void* AppContext
+    _In_reads_(DataBufferCount)
+        const MSH3_BUFFER* DataBuffers,
+    _In_ uint32_t DataBufferCount,
+    _In_opt_ void* AppContext,
+    _In_opt_ MsH3pSharedBuffer* SharedBuffer,
+    _In_ MsH3pSendKind Kind
     )
 {
-    if (Headers && HeadersCount != 0) { // TODO - Make sure headers weren't already sent
-        if (!H3.LocalEncoder->EncodeHeaders(this, Headers, HeadersCount)) return false;
-        auto HeadersLength = Buffers[1].Length + Buffers[2].Length;
-        auto HeaderFlags = Flags;
-        if (Data && DataLength != 0) {
-            HeaderFlags &= ~MSH3_REQUEST_SEND_FLAG_FIN;
-            HeaderFlags |= MSH3_REQUEST_SEND_FLAG_DELAY_SEND;
-        }
-        if (!H3WriteFrameHeader(H3FrameHeaders, HeadersLength, &Buffers[0].Length, sizeof(FrameHeaderBuffer), FrameHeaderBuffer) ||
-            QUIC_FAILED(MsQuicStream::Send(Buffers, 3, ToQuicSendFlags(HeaderFlags)))) {
-            return false;
+    const bool FromApp = Kind == MsH3pSendApp;
+    if (FromApp && FileSendActive) return false; // File send in progress
+
+    if (Flags & MSH3_REQUEST_SEND_FLAG_COALESCE) {
+        if (!Headers && !(Flags & MSH3_REQUEST_SEND_FLAG_FIN)) {
+            if (FromApp && !IsWritable()) return false;
+            return Coalesce(Flags, DataBuffers, DataBufferCount, AppContext);
         }
+        Flags &= ~MSH3_REQUEST_SEND_FLAG_COALESCE;
     }
-    if (Data && DataLength != 0) {
-        auto AppSend = new(std::nothrow) MsH3pAppSend(AppContext); // TODO - Pool alloc
-        if (!AppSend || !AppSend->SetData(Data, DataLength) ||
-            QUIC_FAILED(MsQuicStream::Send(AppSend->Buffers, 2, ToQuicSendFlags(Flags), AppSend))) {
-            delete AppSend;
-            return false;
-        }
+    const bool HasHeaders = Headers && HeadersCount != 0;
+    uint64_t DataLength;
+    if (!ValidateSend(Flags, HasHeaders, DataBuffers, DataBufferCount, &DataLength)) return false;
+    if (FromApp && DataLength != 0 && !IsWritable()) return false; // Sends without data are never held back
+    if (!Flush()) return false; // Keep pending writes in order
+    if (HasHeaders) { // TODO - Make sure headers weren't already sent
+        Buffers[1].Buffer = PrefixBuffer;
+        if (!H3.LocalEncoder->EncodeHeaders(this, Headers, HeadersCount)) return false;
+    }
+    if (!SendFrames(Flags, HasHeaders, nullptr, DataBuffers, DataBufferCount, DataLength, AppContext, SharedBuffer, Kind)) {
+        ReserveHeadersBuffer(0); // Drop any header block not handed off to a send
+        return false;
     }
     return true;
 }
 
-QUIC_STATUS
-MsH3pBiDirStream::MsQuicCallback(
-    _Inout_ QUIC_STREAM_EVENT* Event
+bool
+MsH3pBiDirStream::SendEncoded(
+    _In_ MSH3_REQUEST_SEND_FLAGS Flags,
+    _In_reads_(DataBufferCount)
+        const MSH3_BUFFER* DataBuffers,
+    _In_ uint32_t DataBufferCount,
+    _In_opt_ void* AppContext
+    )
+{
+    uint64_t DataLength;
+    if (!ValidateSend(Flags, true, DataBuffers, DataBufferCount, &DataLength) ||
+        !SendFrames(Flags & ~MSH3_REQUEST_SEND_FLAG_COALESCE, true, nullptr, DataBuffers, DataBufferCount, DataLength, AppContext, nullptr, MsH3pSendApp)) {
+        ReserveHeadersBuffer(0); // Drop any header block not handed off to a send
+        return false;
+    }
+    return true;
+}
+
+bool
+MsH3pBiDirStream::SendTemplate(
+    _In_ MSH3_REQUEST_SEND_FLAGS Flags,
+    _In_ MsH3pHeaderTemplate* Template,
+    _In_reads_(SlotValueCount)
+        const MSH3_BUFFER* SlotValues,
+    _In_ uint32_t SlotValueCount,
+    _In_reads_(DataBufferCount)
+        const MSH3_BUFFER* DataBuffers,
+    _In_ uint32_t DataBufferCount,
+    _In_opt_ void* AppContext
+    )
+{
+    if (FileSendActive || SlotValueCount != Template->SlotCount) return false;
+    uint64_t DataLength;
+    if (!ValidateSend(Flags, true, DataBuffers, DataBufferCount, &DataLength)) return false;
+    if (DataLength != 0 && !IsWritable()) return false; // Headers alone are never held back
+    if (!Flush()) return false; // Keep pending writes in order
+    if (H3.ContentLengthEnabled) {
+        if (Template->MethodSlot != UINT32_MAX) {
+            const auto& Value = SlotValues[Template->MethodSlot];
+            SentHeadRequest =
+                MsH3pParseMethod((const char*)Value.Buffer, Value.Length) == MSH3_METHOD_HEAD;
+        } else if (Template->Method != MSH3_METHOD_NONE) {
+            SentHeadRequest = Template->Method == MSH3_METHOD_HEAD;
+        }
+    }
+
+    Buffers[1].Length = Template->PrefixLength;
+    Buffers[1].Buffer = Template->Prefix;
+    if (Template->SlotCount == 0) {
+        Buffers[2].Length = Template->BlockLength; // Sent by reference
+        Buffers[2].Buffer = Template->Block;
+    } else {
+        //
+        // Interleave the pre-encoded field lines with the slots, each encoded
+        // as its stored name followed by a (non-Huffman) string literal value.
+        //
+        uint64_t Needed = Template->BlockLength;
+        for (uint32_t i = 0; i < Template->SlotCount; ++i) {
+            Needed += Template->Slots[i].NameLength + 10 + (uint64_t)SlotValues[i].Length;
+        }
+        if (Needed > UINT32_MAX) return false;
+        uint8_t* Block = ReserveHeadersBuffer((size_t)Needed);
+        if (!Block) return false;
+
+        uint32_t Offset = 0, BlockOffset = 0;
+        for (uint32_t i = 0; i <= Template->SlotCount; ++i) {
+            const uint32_t NextBlockOffset =
+                i < Template->SlotCount ? Template->Slots[i].BlockOffset : Template->BlockLength;
+            const uint32_t StaticLength = NextBlockOffset - BlockOffset;
+            memcpy(Block + Offset, Template->Block + BlockOffset, StaticLength);
+            Offset += StaticLength;
+            BlockOffset = NextBlockOffset;
+            if (i == Template->SlotCount) break;
+
+            const auto& Slot = Template->Slots[i];
+            memcpy(Block + Offset, Template->Names + Slot.NameOffset, Slot.NameLength);
+            Offset += Slot.NameLength;
+            Offset += H3WritePrefixedInt(0x00, 7, SlotValues[i].Length, Block + Offset);
+            memcpy(Block + Offset, SlotValues[i].Buffer, SlotValues[i].Length);
+            Offset += SlotValues[i].Length;
+        }
+        Buffers[2].Length = Offset;
+    }
+    if (!SendFrames(Flags, true, Template, DataBuffers, DataBufferCount, DataLength, AppContext, nullptr, MsH3pSendApp)) {
+        ReserveHeadersBuffer(0); // Drop any header block not handed off to a send
+        return false;
+    }
+    return true;
+}
+
+bool
+MsH3pBiDirStream::SendFrames(
+    _In_ MSH3_REQUEST_SEND_FLAGS Flags,
+    _In_ bool HasHeaders,
+    _In_opt_ MsH3pHeaderTemplate* Template,
+    _In_reads_(DataBufferCount)
+        const MSH3_BUFFER* DataBuffers,
+    _In_ uint32_t DataBufferCount,
+    _In_ uint64_t DataLength,
+    _In_opt_ void* AppContext,
+    _In_opt_ MsH3pSharedBuffer* SharedBuffer,
+    _In_ MsH3pSendKind Kind
+    )
+{
+    const bool HasData = DataLength != 0;
+
+    //
+    // In declared length mode, all the body is sent under a single DATA frame
+    // header, written with the first data. Later sends just append payload.
+    //
+    bool WriteFrameHeader = true;
+    QUIC_VAR_INT FrameLength = DataLength;
+    if (DeclaredDataLeft != 0) {
+        WriteFrameHeader = !DeclaredFrameHeaderSent;
+        FrameLength = DeclaredDataLeft;
+    }
+
+    if (HasHeaders) {
+        auto HeadersLength = Buffers[1].Length + Buffers[2].Length;
+        Buffers[0].Length = 0;
+        if (!H3WriteFrameHeader(H3FrameHeaders, HeadersLength, &Buffers[0].Length, sizeof(FrameHeaderBuffer), FrameHeaderBuffer)) {
+            return false;
+        }
+        if (!HasData && !Template && !HeadersBlock) {
+            return QUIC_SUCCEEDED(MsQuicStream::Send(Buffers, 3, ToQuicSendFlags(Flags)));
+        }
+    } else if (!HasData) {
+        if (!(Flags & MSH3_REQUEST_SEND_FLAG_FIN)) return true;
+        return QUIC_SUCCEEDED(MsQuicStream::Send(nullptr, 0, ToQuicSendFlags(Flags))); // Just the FIN
+    }
+
+    //
+    // When both headers and data are present (i.e. a typical small response),
+    // the HEADERS and DATA frames are gathered into a single send so they only
+    // take one trip through the MsQuic send queue and result in a single
+    // completion. All the data buffers are framed under one DATA frame header.
+    //
+    auto AppSend = H3.AppSendPool.New<MsH3pAppSend>(AppContext);
+    if (!AppSend) return false;
+
+    //
+    // Small app-owned payloads are copied into a pooled buffer when configured,
+    // so the caller's buffers are free as soon as this returns.
+    //
+    MSH3_BUFFER CopiedData;
+    if (HasData && DataLength <= H3.SendBufferingThreshold &&
+        !SharedBuffer && Kind == MsH3pSendApp) {
+        AppSend->CopyBuffer = H3.SendBufferPool.Alloc();
+        if (!AppSend->CopyBuffer) {
+            H3.AppSendPool.Delete(AppSend);
+            return false;
+        }
+        AppSend->CopyPool = &H3.SendBufferPool;
+        CopiedData.Length = 0;
+        CopiedData.Buffer = (uint8_t*)AppSend->CopyBuffer;
+        for (uint32_t i = 0; i < DataBufferCount; ++i) {
+            memcpy((uint8_t*)AppSend->CopyBuffer + CopiedData.Length, DataBuffers[i].Buffer, DataBuffers[i].Length);
+            CopiedData.Length += DataBuffers[i].Length;
+        }
+        DataBuffers = &CopiedData;
+        DataBufferCount = 1;
+        AppSend->IndicateComplete = AppContext != nullptr; // Optional for copied sends
+    } else if (!HasData && !Template) {
+        AppSend->IndicateComplete = false; // Only here to own a large header block
+    }
+
+    if (!AppSend->Reserve((HasHeaders ? 3 : 0) + (HasData ? 1 + DataBufferCount : 0))) {
+        H3.AppSendPool.Delete(AppSend);
+        return false;
+    }
+    AppSend->Kind = Kind;
+    if (Template) {
+        Template->AddRef();
+        AppSend->Template = Template;
+    }
+    if (SharedBuffer) {
+        SharedBuffer->AddRef();
+        AppSend->SharedBuffer = SharedBuffer;
+    }
+    if (HasHeaders) {
+        AppSend->SetHeaders(Buffers);
+        AppSend->HeadersBlock = HeadersBlock; // Owned by the send from here on
+        HeadersBlock = nullptr;
+    }
+    if (HasData && !AppSend->SetData(DataBuffers, DataBufferCount, WriteFrameHeader, FrameLength)) {
+        H3.AppSendPool.Delete(AppSend);
+        return false;
+    }
+    for (uint32_t i = 0; i < AppSend->BufferCount; ++i) {
+        AppSend->SendLength += AppSend->Buffers[i].Length;
+    }
+    AppSendsInFlight++;
+    BytesInFlight += AppSend->SendLength;
+    if (QUIC_FAILED(MsQuicStream::Send(AppSend->Buffers, AppSend->BufferCount, ToQuicSendFlags(Flags), AppSend))) {
+        AppSendsInFlight--;
+        BytesInFlight -= AppSend->SendLength;
+        H3.AppSendPool.Delete(AppSend);
+        return false;
+    }
+    if (DeclaredDataLeft != 0) {
+        DeclaredDataLeft -= DataLength;
+        DeclaredFrameHeaderSent = DeclaredDataLeft != 0;
+    }
+    return true;
+}
+
+bool
+MsH3pBiDirStream::Coalesce(
+    _In_ MSH3_REQUEST_SEND_FLAGS Flags,
+    _In_reads_(DataBufferCount)
+        const MSH3_BUFFER* DataBuffers,
+    _In_ uint32_t DataBufferCount,
+    _In_opt_ void* AppContext
+    )
+{
+    UNREFERENCED_PARAMETER(Flags);
+    UNREFERENCED_PARAMETER(AppContext);
+    if (DeclaredDataLeft != 0) return false; // Not supported with a declared body length
+    uint64_t DataLength = 0;
+    for (uint32_t i = 0; i < DataBufferCount; ++i) {
+        DataLength += DataBuffers[i].Length;
+    }
+    if (DataLength == 0) return true;
+
+    std::lock_guard Lock{CoalesceLock};
+    if (CoalesceLength + DataLength > MSH3_COALESCE_BUFFER_SIZE &&
+        DataLength <= MSH3_COALESCE_BUFFER_SIZE && !FlushLocked()) {
+        return false; // Keep a write that fits in one buffer in one DATA frame
+    }
+
+    //
+    // Writes are always copied, so the caller's buffers are free on return.
+    // Anything bigger than the buffer is split, flushing each full buffer.
+    //
+    for (uint32_t i = 0; i < DataBufferCount; ++i) {
+        const uint8_t* Data = DataBuffers[i].Buffer;
+        uint32_t Length = DataBuffers[i].Length;
+        while (Length != 0) {
+            if (CoalesceLength == MSH3_COALESCE_BUFFER_SIZE && !FlushLocked()) return false;
+            if (!CoalesceBuffer) {
+                CoalesceBuffer = new(std::nothrow) MsH3pSharedBuffer(MSH3_COALESCE_BUFFER_SIZE);
+                if (CoalesceBuffer && !CoalesceBuffer->Buffer) {
+                    delete CoalesceBuffer;
+                    CoalesceBuffer = nullptr;
+                }
+                if (!CoalesceBuffer) return false;
+            }
+            const uint32_t CopyLength = min(Length, MSH3_COALESCE_BUFFER_SIZE - CoalesceLength);
+            memcpy(CoalesceBuffer->Buffer + CoalesceLength, Data, CopyLength);
+            CoalesceLength += CopyLength;
+            Data += CopyLength;
+            Length -= CopyLength;
+        }
+    }
+
+    //
+    // Like Nagle's algorithm, writes are only held back while an earlier flush
+    // is still outstanding, which bounds the added delay to about one RTT.
+    //
+    return CoalesceFlushesInFlight != 0 || FlushLocked();
+}
+
+bool
+MsH3pBiDirStream::Flush()
+{
+    std::lock_guard Lock{CoalesceLock};
+    return FlushLocked();
+}
+
+bool
+MsH3pBiDirStream::FlushLocked()
+{
+    if (CoalesceLength == 0) return true;
+    auto Buffer = CoalesceBuffer;
+    const MSH3_BUFFER Data = { CoalesceLength, Buffer->Buffer };
+    CoalesceBuffer = nullptr;
+    CoalesceLength = 0;
+    CoalesceFlushesInFlight++; // Before the send, which may complete inline
+    const bool Result =
+        SendFrames(
+            MSH3_REQUEST_SEND_FLAG_NONE, false, nullptr, &Data, 1, Data.Length,
+            nullptr, Buffer, MsH3pSendCoalesced);
+    if (!Result) CoalesceFlushesInFlight--;
+    Buffer->Release(); // The send holds its own reference
+    return Result;
+}
+
+void
+MsH3pBiDirStream::CompleteCoalesced(
+    _In_ MsH3pSharedBuffer* Buffer
+    )
+{
+    std::lock_guard Lock{CoalesceLock};
+    CoalesceFlushesInFlight--;
+    if (!CoalesceBuffer) { // Reuse the buffer for the next writes
+        Buffer->AddRef();
+        CoalesceBuffer = Buffer;
+    } else {
+        (void)FlushLocked();
+    }
+}
+
+bool
+MsH3pBiDirStream::SetSendBodyLength(
+    _In_ uint64_t Length
+    )
+{
+    if (FileSendActive || DeclaredFrameHeaderSent || Length > QUIC_UINT62_MAX) {
+        return false; // A file or previously declared body still in progress
+    }
+    DeclaredDataLeft = Length; // Zero cancels a previous declaration
+    return true;
+}
+
+#ifdef _WIN32
+//
+// Reads or writes at an offset. Handles opened for overlapped I/O complete
+// asynchronously, so those are waited on. The low bit set on the event keeps
+// the completion from also being queued to any completion port the app has
+// associated with the handle.
+//
+static bool
+MsH3pFileIo(
+    _In_ MSH3_FILE File,
+    _In_ bool Write,
+    _In_ uint64_t Offset,
+    _Inout_updates_(Length) uint8_t* Buffer,
+    _In_ uint32_t Length,
+    _Out_ DWORD* BytesDone
+    )
+{
+    HANDLE Event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!Event) return false;
+    OVERLAPPED Overlapped = {};
+    Overlapped.Offset = (DWORD)Offset;
+    Overlapped.OffsetHigh = (DWORD)(Offset >> 32);
+    Overlapped.hEvent = (HANDLE)((ULONG_PTR)Event | 1);
+    *BytesDone = 0;
+    BOOL Result =
+        Write ?
+            WriteFile(File, Buffer, Length, BytesDone, &Overlapped) :
+            ReadFile(File, Buffer, Length, BytesDone, &Overlapped);
+    if (!Result && GetLastError() == ERROR_IO_PENDING) {
+        Result = GetOverlappedResult(File, &Overlapped, BytesDone, TRUE);
+    }
+    CloseHandle(Event);
+    return Result && *BytesDone != 0;
+}
+#endif
+
+static bool
+MsH3pWriteFile(
+    _In_ MSH3_FILE File,
+    _In_ uint64_t Offset,
+    _In_reads_(BufferCount) const MSH3_BUFFER* Buffers,
+    _In_ uint32_t BufferCount
+    )
+{
+#ifdef _WIN32
+    for (uint32_t i = 0; i < BufferCount; ++i) {
+        const uint8_t* Buffer = Buffers[i].Buffer;
+        uint32_t Length = Buffers[i].Length;
+        while (Length != 0) {
+            DWORD BytesWritten;
+            if (!MsH3pFileIo(File, true, Offset, (uint8_t*)Buffer, Length, &BytesWritten)) return false;
+            Offset += BytesWritten;
+            Buffer += BytesWritten;
+            Length -= BytesWritten;
+        }
+    }
+#else
+    struct iovec Iov[MSH3_RECV_SLICES_MAX];
+    for (uint32_t i = 0; i < BufferCount; ++i) {
+        Iov[i].iov_base = (void*)Buffers[i].Buffer;
+        Iov[i].iov_len = Buffers[i].Length;
+    }
+    struct iovec* Cur = Iov;
+    int Count = (int)BufferCount;
+    while (Count != 0) {
+        auto BytesWritten = pwritev(File, Cur, Count, (off_t)Offset);
+        if (BytesWritten < 0 && errno == EINTR) continue;
+        if (BytesWritten <= 0) return false;
+        Offset += BytesWritten;
+        while (Count != 0 && (size_t)BytesWritten >= Cur->iov_len) { // Skip what was fully written
+            BytesWritten -= Cur->iov_len;
+            Cur++;
+            Count--;
+        }
+        if (Count != 0) {
+            Cur->iov_base = (uint8_t*)Cur->iov_base + BytesWritten;
+            Cur->iov_len -= BytesWritten;
+        }
+    }
+#endif
+    return true;
+}
+
+static bool
+MsH3pReadFile(
+    _In_ MSH3_FILE File,
+    _In_ uint64_t Offset,
+    _Out_writes_(Length) uint8_t* Buffer,
+    _In_ uint32_t Length
+    )
+{
+    while (Length != 0) {
+#ifdef _WIN32
+        DWORD BytesRead;
+        if (!MsH3pFileIo(File, false, Offset, Buffer, Length, &BytesRead)) return false;
+#else
+        auto BytesRead = pread(File, Buffer, Length, (off_t)Offset);
+        if (BytesRead < 0 && errno == EINTR) continue;
+        if (BytesRead <= 0) return false; // Error or unexpected end of file
+#endif
+        Offset += BytesRead;
+        Buffer += BytesRead;
+        Length -= (uint32_t)BytesRead;
+    }
+    return true;
+}
+
+bool
+MsH3pBiDirStream::SendFile(
+    _In_ MSH3_REQUEST_SEND_FLAGS Flags,
+    _In_reads_(HeadersCount)
+        const MSH3_HEADER* Headers,
+    _In_ size_t HeadersCount,
+    _In_ MSH3_FILE File,
+    _In_ uint64_t Offset,
+    _In_ uint64_t Length,
+    _In_opt_ void* AppContext
+    )
+{
+    if (FileSendActive || DeclaredDataLeft != 0 || Length == 0 || Length > QUIC_UINT62_MAX || !IsWritable()) {
+        return false;
+    }
+    if (!Flush()) return false; // Keep pending writes in order
+    auto NewFileSend =
+        new(std::nothrow) MsH3pFileSend(
+            File, Offset, Length, Flags & MSH3_REQUEST_SEND_FLAG_FIN, AppContext);
+    if (!NewFileSend) return false;
+
+    //
+    // The whole range is sent as a single DATA frame, with the headers going
+    // out with the first chunk.
+    //
+    DeclaredDataLeft = Length;
+    std::unique_lock Lock{FileSendLock};
+    FileSend = NewFileSend;
+    FileSendActive = true;
+    PumpFileSend(Lock, Headers, HeadersCount);
+    if (!FileSend->Started) { // Nothing went out, so just fail the call
+        FileSend = nullptr;
+        FileSendActive = false;
+        Lock.unlock();
+        delete NewFileSend;
+        DeclaredDataLeft = 0;
+        return false;
+    }
+    CompleteFileSendIfIdle(Lock);
+    return true;
+}
+
+void
+MsH3pBiDirStream::PumpFileSend(
+    _Inout_ std::unique_lock<std::mutex>& Lock,
+    _In_reads_(HeadersCount)
+        const MSH3_HEADER* Headers,
+    _In_ size_t HeadersCount
+    )
+{
+    //
+    // Only one caller pumps at a time, so chunks go out in file order. The
+    // lock is dropped around the read and the send, since MsQuic may complete
+    // a send inline, which takes the lock again in CompleteFileSend.
+    //
+    if (FileSend->Pumping) return;
+    FileSend->Pumping = true;
+
+    //
+    // Keep about the ideal send size (as indicated by MsQuic) in flight, so
+    // memory stays bounded regardless of the size of the file.
+    //
+    auto MaxChunksInFlight = IdealSendSize / MSH3_FILE_SEND_CHUNK_SIZE;
+    if (MaxChunksInFlight == 0) MaxChunksInFlight = 1;
+
+    while (!FileSend->Canceled &&
+           FileSend->LengthLeft != 0 &&
+           FileSend->ChunksInFlight < MaxChunksInFlight) {
+        MsH3pSharedBuffer* Chunk = nullptr;
+        if (!FileSend->FreeChunks.empty()) {
+            Chunk = FileSend->FreeChunks.back();
+            FileSend->FreeChunks.pop_back();
+        } else {
+            Chunk = new(std::nothrow) MsH3pSharedBuffer(MSH3_FILE_SEND_CHUNK_SIZE);
+            if (Chunk && !Chunk->Buffer) {
+                delete Chunk;
+                Chunk = nullptr;
+            }
+        }
+
+        const MSH3_FILE File = FileSend->File;
+        const uint64_t Offset = FileSend->Offset;
+        const uint32_t Length = (uint32_t)min(FileSend->LengthLeft, (uint64_t)MSH3_FILE_SEND_CHUNK_SIZE);
+        const bool Fin = Length == FileSend->LengthLeft && FileSend->Fin;
+        FileSend->Offset += Length;
+        FileSend->LengthLeft -= Length;
+        FileSend->ChunksInFlight++; // Before the send, which may complete inline
+        Lock.unlock();
+
+        const MSH3_BUFFER Buffer = { Length, Chunk ? Chunk->Buffer : nullptr };
+        const bool Sent =
+            Chunk &&
+            MsH3pReadFile(File, Offset, Chunk->Buffer, Length) &&
+            Send(
+                Fin ? MSH3_REQUEST_SEND_FLAG_FIN : MSH3_REQUEST_SEND_FLAG_NONE,
+                Headers, HeadersCount, &Buffer, 1, nullptr, Chunk, MsH3pSendFileChunk);
+        if (!Sent && DeclaredFrameHeaderSent) { // Part of the body already went out
+            (void)Shutdown(H3ErrorInternalError, QUIC_STREAM_SHUTDOWN_FLAG_ABORT_SEND);
+        }
+
+        Lock.lock();
+        if (!Sent) {
+            FileSend->ChunksInFlight--;
+            if (Chunk) FileSend->FreeChunks.push_back(Chunk);
+            FileSend->Canceled = true;
+            break;
+        }
+        FileSend->Started = true;
+        Headers = nullptr;
+        HeadersCount = 0;
+    }
+    FileSend->Pumping = false;
+}
+
+void
+MsH3pBiDirStream::CompleteFileSendIfIdle(
+    _Inout_ std::unique_lock<std::mutex>& Lock
+    )
+{
+    if (FileSend->Pumping || FileSend->ChunksInFlight != 0 ||
+        (FileSend->LengthLeft != 0 && !FileSend->Canceled)) {
+        return;
+    }
+
+    auto Completed = FileSend;
+    FileSend = nullptr;
+    FileSendActive = false;
+    Lock.unlock();
+
+    MSH3_REQUEST_EVENT h3Event = {};
+    h3Event.Type = MSH3_REQUEST_EVENT_SEND_COMPLETE;
+    h3Event.SEND_COMPLETE.Canceled = Completed->Canceled;
+    h3Event.SEND_COMPLETE.ClientContext = Completed->AppContext;
+    Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
+    delete Completed;
+}
+
+void
+MsH3pBiDirStream::CompleteFileSend(
+    _In_ MsH3pSharedBuffer* Chunk,
+    _In_ bool Canceled
+    )
+{
+    std::unique_lock Lock{FileSendLock};
+    FileSend->ChunksInFlight--;
+    FileSend->FreeChunks.push_back(Chunk);
+    if (Canceled) {
+        FileSend->Canceled = true;
+    } else {
+        PumpFileSend(Lock, nullptr, 0);
+    }
+    CompleteFileSendIfIdle(Lock);
+}
+
+bool
+MsH3pBiDirStream::IsWritable()
+{
+    if (H3.SendHighWatermarkPercent == 0) return true;
+    const uint64_t HighWatermark = IdealSendSize * H3.SendHighWatermarkPercent / 100;
+    if (BytesInFlight < HighWatermark) return true;
+    WritableNeeded = true;
+    return BytesInFlight < HighWatermark; // Sends may have completed in the meantime
+}
+
+void
+MsH3pBiDirStream::IndicateWritable()
+{
+    if (!WritableNeeded) return;
+    const uint64_t LowWatermark = IdealSendSize * H3.SendLowWatermarkPercent / 100;
+    if (BytesInFlight <= LowWatermark && WritableNeeded.exchange(false)) {
+        MSH3_REQUEST_EVENT h3Event = {};
+        h3Event.Type = MSH3_REQUEST_EVENT_WRITABLE;
+        Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
+    }
+}
+
+void
+MsH3pBiDirStream::IndicateSendCompleteBatch()
+{
+    MSH3_REQUEST_EVENT h3Event = {};
+    h3Event.Type = MSH3_REQUEST_EVENT_SEND_COMPLETE_BATCH;
+    h3Event.SEND_COMPLETE_BATCH.Count = SendCompleteBatchCount;
+    h3Event.SEND_COMPLETE_BATCH.ClientContexts = SendCompleteBatch;
+    SendCompleteBatchCount = 0;
+    Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
+}
+
+QUIC_STATUS
+MsH3pBiDirStream::MsQuicCallback(
+    _Inout_ QUIC_STREAM_EVENT* Event
     )
 {
     MSH3_REQUEST_EVENT h3Event = {};
+    if (SendCompleteBatchCount != 0 && Event->Type != QUIC_STREAM_EVENT_SEND_COMPLETE) {
+        IndicateSendCompleteBatch(); // Keep completions ordered before other events
+    }
     switch (Event->Type) {
     case QUIC_STREAM_EVENT_START_COMPLETE:
         if (QUIC_FAILED(Event->START_COMPLETE.Status)) {
@@ -1139,19 +2249,44 @@ MsH3pBiDirStream::MsQuicCallback(
     case QUIC_STREAM_EVENT_SEND_COMPLETE:
         if (Event->SEND_COMPLETE.ClientContext) {
             auto AppSend = (MsH3pAppSend*)Event->SEND_COMPLETE.ClientContext;
-            h3Event.Type = MSH3_REQUEST_EVENT_SEND_COMPLETE;
-            h3Event.SEND_COMPLETE.Canceled = FALSE;
-            h3Event.SEND_COMPLETE.ClientContext = AppSend->AppContext;
-            Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
-            delete AppSend;
+            const bool Drained = --AppSendsInFlight == 0;
+            BytesInFlight -= AppSend->SendLength;
+            if (AppSend->Kind == MsH3pSendCoalesced) {
+                CompleteCoalesced(AppSend->SharedBuffer);
+            } else if (AppSend->Kind == MsH3pSendFileChunk) {
+                if (SendCompleteBatchCount != 0) IndicateSendCompleteBatch();
+                CompleteFileSend(AppSend->SharedBuffer, Event->SEND_COMPLETE.Canceled);
+            } else if (!AppSend->IndicateComplete) {
+                // Nothing for the app to be told about
+            } else if (H3.SendCompleteBatchEnabled && !Event->SEND_COMPLETE.Canceled) {
+                SendCompleteBatch[SendCompleteBatchCount++] = AppSend->AppContext;
+            } else {
+                if (SendCompleteBatchCount != 0) IndicateSendCompleteBatch();
+                h3Event.Type = MSH3_REQUEST_EVENT_SEND_COMPLETE;
+                h3Event.SEND_COMPLETE.Canceled = Event->SEND_COMPLETE.Canceled;
+                h3Event.SEND_COMPLETE.ClientContext = AppSend->AppContext;
+                Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
+            }
+            H3.AppSendPool.Delete(AppSend);
+            if (SendCompleteBatchCount == MSH3_SEND_COMPLETE_BATCH_SIZE ||
+                (SendCompleteBatchCount != 0 && Drained)) {
+                IndicateSendCompleteBatch();
+            }
+            IndicateWritable();
         }
         break;
     case QUIC_STREAM_EVENT_PEER_SEND_SHUTDOWN:
+        if (ReceiveAborted) break;
+        if (ContentLength != UINT64_MAX && ReceivedBodyLength != ContentLength) { // Less DATA than declared
+            AbortReceive(H3ErrorMessageError, true);
+            break;
+        }
         Complete = true;
         h3Event.Type = MSH3_REQUEST_EVENT_PEER_SEND_SHUTDOWN;
         Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
         break;
     case QUIC_STREAM_EVENT_PEER_SEND_ABORTED:
+        if (ReceiveAborted) break;
         Complete = true;
         h3Event.Type = MSH3_REQUEST_EVENT_PEER_SEND_ABORTED;
         h3Event.PEER_SEND_ABORTED.ErrorCode = Event->PEER_SEND_ABORTED.ErrorCode;
@@ -1179,6 +2314,15 @@ MsH3pBiDirStream::MsQuicCallback(
         h3Event.Type = MSH3_REQUEST_EVENT_IDEAL_SEND_SIZE;
         h3Event.IDEAL_SEND_SIZE.ByteCount = Event->IDEAL_SEND_BUFFER_SIZE.ByteCount;
         Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
+        IdealSendSize = Event->IDEAL_SEND_BUFFER_SIZE.ByteCount;
+        IndicateWritable(); // The watermarks may have moved
+        if (FileSendActive) {
+            std::unique_lock Lock{FileSendLock};
+            if (FileSend) {
+                PumpFileSend(Lock, nullptr, 0);
+                CompleteFileSendIfIdle(Lock);
+            }
+        }
         break;
     //case QUIC_STREAM_EVENT_PEER_ACCEPTED: break; // TODO - Indicate up?
     default: break;
@@ -1191,17 +2335,80 @@ MsH3pBiDirStream::Receive(
     _Inout_ QUIC_STREAM_EVENT* Event
     )
 {
-    for (uint32_t i = 0; i < Event->RECEIVE.BufferCount; ++i) {
-        const QUIC_BUFFER* Buffer = Event->RECEIVE.Buffers + i;
-        do {
+    RecvBuffers = Event->RECEIVE.Buffers;
+    RecvBufferCount = Event->RECEIVE.BufferCount;
+    RecvBufferIndex = 0;
+    ScannedFrameCount = 0;
+    uint64_t CompleteLength;
+    if (H3.ReceiveRetainEnabled) {
+        //
+        // The whole event is always parsed (indications are never pended in
+        // this mode), and MsQuic (in multi-receive mode) is told about it up
+        // to the first byte the app still retains. Once aborted, the event is
+        // dropped, but still accounted for, since MsQuic only counts bytes.
+        //
+        if (!ReceiveAborted) (void)ProcessReceive(&CompleteLength);
+        {
+            std::lock_guard Lock{ReceiveLock};
+            RecvEventOffset += Event->RECEIVE.TotalBufferLength;
+            CompleteLength = AdvanceRetainedCompletion();
+        }
+        if (CompleteLength != 0) {
+            (void)ReceiveComplete(CompleteLength);
+        }
+        return QUIC_STATUS_PENDING;
+    }
+    if (ReceiveAborted) {
+        return QUIC_STATUS_SUCCESS; // Already aborted, so just drop it
+    }
+    if (!ProcessReceive(&CompleteLength)) {
+        return QUIC_STATUS_PENDING; // Resumed by CompleteReceive
+    }
+    if (CompleteLength < Event->RECEIVE.TotalBufferLength) {
+        Event->RECEIVE.TotalBufferLength = CompleteLength; // Partial receive
+    }
+    return QUIC_STATUS_SUCCESS;
+}
+
+//
+// Parses (or continues parsing) the frames in the current receive event.
+// Returns false if the app pended a DATA_RECEIVED(_V) indication, in which case
+// parsing is parked until the app calls CompleteReceive. Otherwise returns
+// true with the number of bytes of the event that were consumed, which is
+// less than the total if the app only accepted part of the data.
+//
+bool
+MsH3pBiDirStream::ProcessReceive(
+    _Out_ uint64_t* CompleteLength
+    )
+{
+    for (; RecvBufferIndex < RecvBufferCount; ++RecvBufferIndex) {
+        const QUIC_BUFFER* Buffer = RecvBuffers + RecvBufferIndex;
+        while (CurRecvOffset < Buffer->Length) {
             if (CurFrameLengthLeft == 0) { // Not in the middle of reading frame payload
+                if (ReceiveAborted) return DiscardReceive(CompleteLength);
                 if (BufferedHeadersLength == 0) { // No partial frame header bufferred
-                    if (!MsH3pVarIntDecode(Buffer->Length, Buffer->Buffer, &CurRecvOffset, &CurFrameType) ||
-                        !MsH3pVarIntDecode(Buffer->Length, Buffer->Buffer, &CurRecvOffset, &CurFrameLength)) {
+                    //
+                    // Frame headers are scanned ahead in batches, which the
+                    // state machine then consumes one frame at a time.
+                    //
+                    if (ScannedFrameIndex >= ScannedFrameCount ||
+                        ScannedFrames[ScannedFrameIndex].HeaderOffset != CurRecvOffset) {
+                        ScannedFrameIndex = 0;
+                        ScannedFrameCount =
+                            MsH3pScanFrames(
+                                Buffer->Buffer, Buffer->Length, CurRecvOffset,
+                                ScannedFrames, MSH3_SCAN_FRAMES_MAX);
+                    }
+                    if (ScannedFrameCount == 0) { // Frame header split across buffers
                         BufferedHeadersLength = Buffer->Length - CurRecvOffset;
                         memcpy(BufferedHeaders, Buffer->Buffer + CurRecvOffset, BufferedHeadersLength);
                         break;
                     }
+                    const H3FrameRef& Frame = ScannedFrames[ScannedFrameIndex++];
+                    CurFrameType = Frame.Type;
+                    CurFrameLength = Frame.Length;
+                    CurRecvOffset = Frame.PayloadOffset;
                 } else { // Partial frame header bufferred already
                     uint32_t ToCopy = sizeof(BufferedHeaders) - BufferedHeadersLength;
                     if (ToCopy > Buffer->Length) ToCopy = Buffer->Length;
@@ -1215,6 +2422,13 @@ MsH3pBiDirStream::Receive(
                     BufferedHeadersLength = 0;
                 }
                 CurFrameLengthLeft = CurFrameLength;
+                if (CurFrameType == H3FrameData) {
+                    ReceivedBodyLength += CurFrameLength;
+                    if (ReceivedBodyLength > ContentLength) { // More DATA than declared
+                        AbortReceive(H3ErrorMessageError, true);
+                        return DiscardReceive(CompleteLength);
+                    }
+                }
             }
 
             uint32_t AvailFrameLength;
@@ -1224,81 +2438,281 @@ MsH3pBiDirStream::Receive(
                 AvailFrameLength = (uint32_t)CurFrameLengthLeft;
             }
 
-            if (CurFrameType == H3FrameData) {
-                ReceivePending = true;
+            if (CurFrameType == H3FrameData && (H3.ReceiveVectoredEnabled || ReceiveToFile)) {
+                if (AvailFrameLength != 0) {
+                    if (RecvSliceCount == 0) {
+                        RecvSliceOffset = RecvEventOffset + CurRecvCompleteLength + CurRecvOffset;
+                    }
+                    RecvSlices[RecvSliceCount].Length = AvailFrameLength;
+                    RecvSlices[RecvSliceCount].Buffer = (uint8_t*)Buffer->Buffer + CurRecvOffset;
+                    RecvSliceCount++;
+                    RecvSliceLength += AvailFrameLength;
+                }
+                CurFrameLengthLeft -= AvailFrameLength;
+                CurRecvOffset += AvailFrameLength;
+                if (RecvSliceCount == MSH3_RECV_SLICES_MAX && !IndicateReceivedSlices()) {
+                    return false;
+                }
+                continue;
+
+            } else if (CurFrameType == H3FrameData) {
+                {
+                    std::lock_guard Lock{ReceiveLock};
+                    ReceivePending = true;
+                    ReceivePendingSlices = false;
+                    ReceivePendingLength = AvailFrameLength;
+                    ReceiveParked = false;
+                }
+                RetainOffset = RecvEventOffset + CurRecvCompleteLength + CurRecvOffset;
+                if (H3.ReceiveRetainEnabled) RetainThread = std::this_thread::get_id();
                 MSH3_REQUEST_EVENT h3Event = {};
                 h3Event.Type = MSH3_REQUEST_EVENT_DATA_RECEIVED;
                 h3Event.DATA_RECEIVED.Data = Buffer->Buffer + CurRecvOffset;
                 h3Event.DATA_RECEIVED.Length = AvailFrameLength;
                 MSH3_STATUS Status = Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
-                if (Status == MSH3_STATUS_SUCCESS) {
-                    ReceivePending = false; // Not pending receive
-                    if (h3Event.DATA_RECEIVED.Length < AvailFrameLength) { // Partial receive case
-                        CurFrameLengthLeft -= h3Event.DATA_RECEIVED.Length;
-                        Event->RECEIVE.TotalBufferLength =
-                            CurRecvCompleteLength + CurRecvOffset + h3Event.DATA_RECEIVED.Length;
-                        CurRecvCompleteLength = 0;
-                        CurRecvOffset = 0;
-                        return QUIC_STATUS_SUCCESS;
-                    }
-                } else if (Status == MSH3_STATUS_PENDING) { // Receive pending (but may have been completed via API call already)
-                    if (!ReceivePending) {
-                        // TODO - Support continuing this receive since it was completed via the API call
+                uint32_t Consumed = h3Event.DATA_RECEIVED.Length;
+                RetainThread = std::thread::id();
+                if (H3.ReceiveRetainEnabled) { // Always consumed whole; retained instead
+                    Status = MSH3_STATUS_SUCCESS;
+                    Consumed = AvailFrameLength;
+                }
+                {
+                    std::lock_guard Lock{ReceiveLock};
+                    if (Status == MSH3_STATUS_PENDING) {
+                        if (ReceivePending) {
+                            ParkReceive();
+                            return false;
+                        }
+                        Consumed = ReceiveCompletedLength; // Already completed via the API call
                     }
-                    return QUIC_STATUS_PENDING;
-                } else {
-                    // TODO - Assert
+                    ReceivePending = false;
+                }
+                if (!ConsumeReceivedData(Consumed, AvailFrameLength, CompleteLength)) {
+                    return true; // Partial receive
                 }
+                continue;
+
             } else if (CurFrameType == H3FrameHeaders) {
+                if (RecvSliceCount != 0 && !IndicateReceivedSlices()) {
+                    return false; // Trailers are only indicated after the data before them
+                }
+                //
+                // This may run on an app thread resuming a pended receive, so
+                // the connection's decoder is locked against the worker. The
+                // headers are only indicated once it's unlocked, since the app
+                // may wait on the worker (e.g. closing another request).
+                //
                 const uint8_t* Frame = Buffer->Buffer + CurRecvOffset;
-                if (CurFrameLengthLeft == CurFrameLength) {
-                    auto StreamId = ID();
-                    auto rhs =
-                        lsqpack_dec_header_in(
-                            &H3.Decoder, this, StreamId, (size_t)CurFrameLength, &Frame,
-                            AvailFrameLength, nullptr, nullptr);
-                    // LQRHS_NEED is expected - it means we need more header block data
-                    // LQRHS_BLOCKED is also expected - it means we need more encoder stream data
-                    if (rhs == LQRHS_ERROR) {
-                        printf("lsqpack_dec_header_in error\n");
-                    } else if (rhs == LQRHS_BLOCKED) {
-                        printf("[QPACK Debug] Header block blocked, waiting for encoder stream data\n");
-                    } else if (rhs == LQRHS_NEED) {
-                        //printf("[QPACK Debug] Header block needs more data\n");
-                    } else if (H3.DynamicQPackEnabled) { // LQRHS_DONE
-                        H3.LocalDecoder->SendQPackAcknowledgment(StreamId);
+                enum lsqpack_read_header_status rhs;
+                {
+                    std::lock_guard Lock{H3.DecoderLock};
+                    if (CurFrameLengthLeft == CurFrameLength) {
+                        SectionHeaders.clear(); // From any earlier section that failed to decode
+                        SectionHasPseudoHeaders = false;
+                        SectionContentLength = UINT64_MAX;
+                        SectionContentLengthInvalid = false;
+                        SectionTooLarge = false;
+                        DecodeSectionSize = 0;
+                        DecodeLength = 0;
+                        rhs =
+                            lsqpack_dec_header_in(
+                                &H3.Decoder, this, ID(), (size_t)CurFrameLength, &Frame,
+                                AvailFrameLength, nullptr, nullptr);
+                    } else { // Continued from a previous partial read
+                        rhs =
+                            lsqpack_dec_header_read(
+                                &H3.Decoder, this, &Frame, AvailFrameLength, nullptr,
+                                nullptr);
                     }
-                } else { // Continued from a previous partial read
-                    auto rhs =
-                        lsqpack_dec_header_read(
-                            &H3.Decoder, this, &Frame, AvailFrameLength, nullptr,
-                            nullptr);
-                    // LQRHS_NEED is expected - it means we need more header block data
-                    // LQRHS_BLOCKED is also expected - it means we need more encoder stream data
-                    if (rhs == LQRHS_ERROR) {
-                        printf("lsqpack_dec_header_read error\n");
-                    } else if (rhs == LQRHS_BLOCKED) {
-                        printf("[QPACK Debug] Header read blocked, waiting for encoder stream data\n");
-                    } else if (rhs == LQRHS_NEED) {
-                        //printf("[QPACK Debug] Header read needs more data\n");
-                    } else if (H3.DynamicQPackEnabled) { // LQRHS_DONE
+                    if (rhs == LQRHS_DONE && H3.DynamicQPackEnabled) {
                         H3.LocalDecoder->SendQPackAcknowledgment(ID());
                     }
                 }
+                // LQRHS_NEED is expected - it means we need more header block data
+                // LQRHS_BLOCKED is also expected - it means we need more encoder stream data
+                if (rhs == LQRHS_ERROR) {
+                    //
+                    // The section can't be indicated, so the message is
+                    // unusable; don't deliver the body without its headers.
+                    //
+                    ReleaseDecodeBuffer();
+                    if (SectionTooLarge) {
+                        AbortReceive(H3ErrorExcessiveLoad, true);
+                    } else {
+                        printf("lsqpack header decode error\n");
+                        AbortReceive(H3ErrorQPackDecompressionFailed, true);
+                    }
+                    return DiscardReceive(CompleteLength);
+                } else if (rhs == LQRHS_BLOCKED) {
+                    printf("[QPACK Debug] Header block blocked, waiting for encoder stream data\n");
+                } else if (rhs == LQRHS_NEED) {
+                    //printf("[QPACK Debug] Header block needs more data\n");
+                } else { // LQRHS_DONE
+                    if (H3.HeadersCompleteEnabled) {
+                        IndicateHeadersComplete();
+                    } else {
+                        IndicateDecodedHeaders();
+                    }
+                    ReleaseDecodeBuffer();
+                    if (H3.ContentLengthEnabled && !ReceiveAborted) {
+                        CompleteContentLength();
+                    }
+                    if (ReceiveAborted) return DiscardReceive(CompleteLength);
+                }
             }
 
             CurFrameLengthLeft -= AvailFrameLength;
             CurRecvOffset += AvailFrameLength;
-
-        } while (CurRecvOffset < Buffer->Length);
+        }
 
         CurRecvCompleteLength += Buffer->Length;
         CurRecvOffset = 0;
+        ScannedFrameCount = 0; // Only valid within the buffer
+    }
+
+    if (RecvSliceCount != 0 && !IndicateReceivedSlices()) {
+        return false;
     }
 
+    *CompleteLength = CurRecvCompleteLength;
     CurRecvCompleteLength = 0;
+    return true;
+}
 
-    return QUIC_STATUS_SUCCESS;
+//
+// Drops the rest of the receive event after the message was aborted.
+//
+bool
+MsH3pBiDirStream::DiscardReceive(
+    _Out_ uint64_t* CompleteLength
+    )
+{
+    uint64_t Length = CurRecvCompleteLength;
+    for (; RecvBufferIndex < RecvBufferCount; ++RecvBufferIndex) {
+        Length += RecvBuffers[RecvBufferIndex].Length;
+    }
+    *CompleteLength = Length;
+    CurRecvCompleteLength = 0;
+    CurRecvOffset = 0;
+    CurFrameLengthLeft = 0;
+    RecvSliceCount = 0;
+    RecvSliceLength = 0;
+    ScannedFrameCount = 0;
+    return true;
+}
+
+//
+// Indicates the collected DATA payload slices as one DATA_RECEIVED_V event.
+// The batch is always consumed as a whole. Returns false if the app pended
+// it, in which case parsing is parked until the app calls CompleteReceive.
+//
+bool
+MsH3pBiDirStream::IndicateReceivedSlices()
+{
+    if (ReceiveToFile) {
+        WriteReceivedSlices();
+        return true;
+    }
+    {
+        std::lock_guard Lock{ReceiveLock};
+        ReceivePending = true;
+        ReceivePendingSlices = true;
+        ReceivePendingLength = 0;
+        ReceiveParked = false;
+    }
+    MSH3_REQUEST_EVENT h3Event = {};
+    h3Event.Type = MSH3_REQUEST_EVENT_DATA_RECEIVED_V;
+    h3Event.DATA_RECEIVED_V.BufferCount = RecvSliceCount;
+    h3Event.DATA_RECEIVED_V.Buffers = RecvSlices;
+    h3Event.DATA_RECEIVED_V.TotalLength = RecvSliceLength;
+    RetainOffset = RecvSliceOffset;
+    if (H3.ReceiveRetainEnabled) RetainThread = std::this_thread::get_id();
+    MSH3_STATUS Status = Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
+    RetainThread = std::thread::id();
+    RecvSliceCount = 0;
+    RecvSliceLength = 0;
+    std::lock_guard Lock{ReceiveLock};
+    if (Status == MSH3_STATUS_PENDING && ReceivePending && !H3.ReceiveRetainEnabled) {
+        ParkReceive();
+        return false;
+    }
+    ReceivePending = false;
+    return true;
+}
+
+//
+// Writes the collected DATA payload slices to the receive file, with a single
+// vectored write in the common case, before the receive is completed back to
+// MsQuic. A failed write aborts the receive side with H3_INTERNAL_ERROR.
+//
+void
+MsH3pBiDirStream::WriteReceivedSlices()
+{
+    if (!ReceiveAborted) { // Otherwise just dropped
+        if (MsH3pWriteFile(ReceiveFile, ReceiveFileOffset, RecvSlices, RecvSliceCount)) {
+            ReceiveFileOffset += RecvSliceLength;
+        } else {
+            printf("Receive file write failed\n");
+            AbortReceive(H3ErrorInternalError, false);
+        }
+    }
+    RecvSliceCount = 0;
+    RecvSliceLength = 0;
+}
+
+bool
+MsH3pBiDirStream::SetReceiveFile(
+    _In_ MSH3_FILE File,
+    _In_ uint64_t Offset
+    )
+{
+    if (ReceiveToFile || ReceivedBodyLength != 0 || ReceiveAborted) {
+        return false; // Too late, some body data was already indicated
+    }
+    ReceiveFile = File;
+    ReceiveFileOffset = Offset;
+    ReceiveToFile = true;
+    return true;
+}
+
+//
+// Parks the parser, called with ReceiveLock held. MsQuic's buffers stay valid
+// until the receive is completed, but the array describing them doesn't
+// outlive the event, so the rest of it is copied.
+//
+void
+MsH3pBiDirStream::ParkReceive()
+{
+    uint32_t Count = RecvBufferCount - RecvBufferIndex;
+    if (Count > MSH3_PARKED_RECV_BUFFERS) {
+        Count = 1; // The rest are indicated again after a partial completion
+    }
+    if (RecvBuffers != ParkedRecvBuffers || RecvBufferIndex != 0) {
+        memmove(ParkedRecvBuffers, RecvBuffers + RecvBufferIndex, Count * sizeof(QUIC_BUFFER));
+    }
+    RecvBuffers = ParkedRecvBuffers;
+    RecvBufferCount = Count;
+    RecvBufferIndex = 0;
+    ReceiveParked = true;
+}
+
+bool
+MsH3pBiDirStream::ConsumeReceivedData(
+    _In_ uint32_t Consumed,
+    _In_ uint32_t Indicated,
+    _Out_ uint64_t* CompleteLength
+    )
+{
+    if (Consumed > Indicated) Consumed = Indicated;
+    CurFrameLengthLeft -= Consumed;
+    if (Consumed < Indicated) { // Partial receive case
+        *CompleteLength = CurRecvCompleteLength + CurRecvOffset + Consumed;
+        CurRecvCompleteLength = 0;
+        CurRecvOffset = 0;
+        return false;
+    }
+    CurRecvOffset += Consumed;
+    return true;
 }
 
 void
@@ -1306,24 +2720,133 @@ MsH3pBiDirStream::CompleteReceive(
     _In_ uint32_t Length
     )
 {
-    if (ReceivePending) {
+    {
+        std::lock_guard Lock{ReceiveLock};
+        if (!ReceivePending) return;
         ReceivePending = false;
-        CurFrameLengthLeft -= Length;
-        auto CompleteLength = CurRecvCompleteLength + CurRecvOffset + Length;
-        CurRecvCompleteLength = 0;
-        CurRecvOffset = 0;
+        if (!ReceiveParked) { // Still in the callback, so let the parser pick it up
+            ReceiveCompletedLength = Length;
+            return;
+        }
+        ReceiveParked = false;
+    }
+
+    //
+    // Continue with the rest of the parked receive event on this thread, and
+    // complete it back to MsQuic once it's consumed or parked again.
+    //
+    uint64_t CompleteLength;
+    if ((ReceivePendingSlices || // Vectored indications are consumed whole
+         ConsumeReceivedData(Length, ReceivePendingLength, &CompleteLength)) &&
+        !ProcessReceive(&CompleteLength)) {
+        return;
+    }
+    (void)ReceiveComplete(CompleteLength);
+}
+
+//
+// Retains the data indicated by the current DATA_RECEIVED(_V) callback, so it
+// stays valid until released. Returns the retain id, or 0 on failure.
+//
+uint64_t
+MsH3pBiDirStream::RetainReceive()
+{
+    //
+    // Only the thread running the indication may retain it; RetainOffset is
+    // meaningless to any other thread.
+    //
+    if (RetainThread.load(std::memory_order_relaxed) != std::this_thread::get_id()) return 0;
+    std::lock_guard Lock{ReceiveLock};
+    if (!RetainedRecvs.empty() &&
+        RetainedRecvs.back().Offset == RetainOffset &&
+        !RetainedRecvs.back().Released) {
+        return RetainedRecvHeadId + RetainedRecvs.size() - 1; // Already retained
+    }
+    RetainedRecvs.push_back({RetainOffset, false});
+    return RetainedRecvHeadId + RetainedRecvs.size() - 1;
+}
+
+void
+MsH3pBiDirStream::ReleaseReceive(
+    _In_ uint64_t RetainId
+    )
+{
+    uint64_t CompleteLength;
+    {
+        std::lock_guard Lock{ReceiveLock};
+        if (RetainId < RetainedRecvHeadId ||
+            RetainId - RetainedRecvHeadId >= RetainedRecvs.size()) {
+            return; // Unknown or already released
+        }
+        RetainedRecvs[RetainId - RetainedRecvHeadId].Released = true;
+        CompleteLength = AdvanceRetainedCompletion();
+    }
+    if (CompleteLength != 0) {
         (void)ReceiveComplete(CompleteLength);
     }
 }
 
+//
+// Drops released data from the head of the retained list and returns how many
+// more bytes can now be completed back to MsQuic, which only accounts for
+// received data in order. Called with ReceiveLock held.
+//
+uint64_t
+MsH3pBiDirStream::AdvanceRetainedCompletion()
+{
+    while (!RetainedRecvs.empty() && RetainedRecvs.front().Released) {
+        RetainedRecvs.pop_front();
+        RetainedRecvHeadId++;
+    }
+    uint64_t Frontier =
+        RetainedRecvs.empty() ? RecvEventOffset : RetainedRecvs.front().Offset;
+    if (Frontier <= RecvCompletedOffset) return 0;
+    uint64_t CompleteLength = Frontier - RecvCompletedOffset;
+    RecvCompletedOffset = Frontier;
+    return CompleteLength;
+}
+
 struct lsxpack_header*
 MsH3pBiDirStream::DecodePrepare(
     struct lsxpack_header* Header,
     size_t Space
     )
 {
-    if (Space > sizeof(DecodeBuffer)) {
+    if (H3.HeadersCompleteEnabled) {
+        //
+        // Decode straight into the request's header arena, so the section
+        // can be indicated as a whole without copying.
+        //
+        if (Space > LSXPACK_MAX_STRLEN || Space > H3.MaxFieldSectionSize) {
+            printf("Header too big, %zu\n", Space);
+            SectionTooLarge = true;
+            return nullptr;
+        }
+        if (Header) { // More space needed for the current header
+            if (!HeaderArena.Extend(Header->buf, Space)) {
+                auto Buffer = (char*)HeaderArena.Alloc(Space);
+                if (!Buffer) { SectionTooLarge = true; return nullptr; }
+                memcpy(Buffer, Header->buf, Header->val_len);
+                Header->buf = Buffer;
+            }
+            Header->val_len = (lsxpack_strlen_t)Space;
+        } else {
+            auto Buffer = (char*)HeaderArena.Alloc(Space);
+            if (!Buffer) { SectionTooLarge = true; return nullptr; }
+            Header = &CurDecodeHeader;
+            lsxpack_header_prepare_decode(Header, Buffer, 0, Space);
+        }
+        return Header;
+    }
+    //
+    // The whole section is kept, so each header is decoded after the ones
+    // before it, leaving room for its record.
+    //
+    const size_t Offset = DecodeLength + sizeof(MsH3pDecodedHeader);
+    if (Space > LSXPACK_MAX_STRLEN ||
+        !GrowDecodeBuffer(Offset + Space, Header ? Offset + Header->val_len : DecodeLength)) {
         printf("Header too big, %zu\n", Space);
+        SectionTooLarge = true;
         return nullptr;
     }
     if (Header) {
@@ -1331,27 +2854,411 @@ MsH3pBiDirStream::DecodePrepare(
         Header->val_len = (lsxpack_strlen_t)Space;
     } else {
         Header = &CurDecodeHeader;
-        lsxpack_header_prepare_decode(Header, DecodeBuffer, 0, Space);
+        lsxpack_header_prepare_decode(Header, DecodeBuffer, (lsxpack_offset_t)Offset, Space);
     }
     return Header;
 }
 
+//
+// Makes sure the decode buffer has at least Space bytes, keeping the first
+// PreserveLength bytes. The common case is served from the connection's pool;
+// bigger sections get a heap buffer up to the max field section size.
+//
+bool
+MsH3pBiDirStream::GrowDecodeBuffer(
+    _In_ size_t Space,
+    _In_ size_t PreserveLength
+    )
+{
+    if (Space <= DecodeBufferSize) return true;
+    if (Space > LSXPACK_MAX_STRLEN || Space > H3.MaxFieldSectionSize) return false;
+    char* Buffer;
+    size_t Size;
+    if (Space <= MSH3_DECODE_BUFFER_POOL_SIZE) {
+        Buffer = (char*)H3.DecodeBufferPool.Alloc();
+        Size = MSH3_DECODE_BUFFER_POOL_SIZE;
+    } else {
+        Size = Space < 2 * (size_t)DecodeBufferSize ? 2 * (size_t)DecodeBufferSize : Space;
+        if (Size > H3.MaxFieldSectionSize) Size = H3.MaxFieldSectionSize;
+        if (Size > LSXPACK_MAX_STRLEN) Size = LSXPACK_MAX_STRLEN;
+        Buffer = (char*)malloc(Size);
+    }
+    if (!Buffer) return false;
+    if (PreserveLength) memcpy(Buffer, DecodeBuffer, PreserveLength);
+    ReleaseDecodeBuffer();
+    DecodeBuffer = Buffer;
+    DecodeBufferSize = (uint32_t)Size;
+    return true;
+}
+
 void
+MsH3pBiDirStream::ReleaseDecodeBuffer()
+{
+    if (!DecodeBuffer) return;
+    if (DecodeBufferSize == MSH3_DECODE_BUFFER_POOL_SIZE) {
+        H3.DecodeBufferPool.Free(DecodeBuffer);
+    } else {
+        free(DecodeBuffer);
+    }
+    DecodeBuffer = nullptr;
+    DecodeBufferSize = 0;
+    DecodeLength = 0;
+}
+
+bool
 MsH3pBiDirStream::DecodeProcess(
     struct lsxpack_header* Header
     )
 {
+    DecodeSectionSize += Header->name_len + Header->val_len + H3_FIELD_LINE_OVERHEAD;
+    if (DecodeSectionSize > H3.MaxFieldSectionSize) {
+        printf("Header section too big, %u\n", DecodeSectionSize);
+        SectionTooLarge = true;
+        return false;
+    }
     const MSH3_HEADER h {
         .Name = Header->buf + Header->name_offset,
         .NameLength = Header->name_len,
         .Value = Header->buf + Header->val_offset,
         .ValueLength = Header->val_len };
+    auto Field = MsH3pGetPseudoHeader(Header);
+    if (H3.ContentLengthEnabled && Field == H3PseudoHeaderNone && MsH3pIsContentLength(Header)) {
+        RecordContentLength(h);
+    }
+    if (H3.HeadersCompleteEnabled) {
+        HeaderArena.Trim(Header->buf, Header->val_offset + Header->val_len);
+        if (Field != H3PseudoHeaderNone) RecordPseudoHeader(Field, h);
+        SectionHeaders.push_back(h);
+        return true;
+    }
+
+    //
+    // The decoder is locked, so the app isn't called here; the header is
+    // indicated with the rest of the section by IndicateDecodedHeaders.
+    //
+    const MsH3pDecodedHeader Record {
+        (uint32_t)Header->name_offset, Header->name_len,
+        (uint32_t)Header->val_offset, Header->val_len, Field };
+    memcpy(DecodeBuffer + Header->name_offset - sizeof(Record), &Record, sizeof(Record));
+    DecodeLength = Record.ValueOffset + Record.ValueLength;
+    return true;
+}
+
+//
+// Records a pseudo-header of the section being decoded, for the app once the
+// section's are all known. The views point to where the value was decoded: the
+// header arena with HEADERS_COMPLETE, DecodeBuffer otherwise.
+//
+void
+MsH3pBiDirStream::RecordPseudoHeader(
+    _In_ H3PseudoHeader Field,
+    _In_ const MSH3_HEADER& Header
+    )
+{
+    if (!SectionHasPseudoHeaders) {
+        SectionPseudoHeaders = {};
+        SectionHasPseudoHeaders = true;
+    }
+    if (Field == H3PseudoHeaderMethod) {
+        SectionPseudoHeaders.Method = MsH3pParseMethod(Header.Value, Header.ValueLength);
+    } else if (Field == H3PseudoHeaderStatus) {
+        SectionPseudoHeaders.Status = MsH3pParseStatus(Header.Value, Header.ValueLength);
+    } else if (Field == H3PseudoHeaderPath) {
+        SectionPseudoHeaders.Path = Header.Value;
+        SectionPseudoHeaders.PathLength = (uint32_t)Header.ValueLength;
+    } else if (Field == H3PseudoHeaderAuthority) {
+        SectionPseudoHeaders.Authority = Header.Value;
+        SectionPseudoHeaders.AuthorityLength = (uint32_t)Header.ValueLength;
+    } else {
+        SectionPseudoHeaders.Scheme = Header.Value;
+        SectionPseudoHeaders.SchemeLength = (uint32_t)Header.ValueLength;
+    }
+}
+
+//
+// Makes the current section's pseudo-headers, if it had any, the ones returned
+// by MsH3RequestGetPseudoHeaders. Clear drops the views once DecodeBuffer, which
+// they point into without HEADERS_COMPLETE, is released.
+//
+void
+MsH3pBiDirStream::PublishPseudoHeaders(
+    _In_ bool Clear
+    )
+{
+    if (!SectionHasPseudoHeaders) return;
+    if (Clear) {
+        SectionPseudoHeaders.Path = nullptr;
+        SectionPseudoHeaders.PathLength = 0;
+        SectionPseudoHeaders.Authority = nullptr;
+        SectionPseudoHeaders.AuthorityLength = 0;
+        SectionPseudoHeaders.Scheme = nullptr;
+        SectionPseudoHeaders.SchemeLength = 0;
+    }
+    std::lock_guard Lock{ReceiveLock};
+    PseudoHeaders = SectionPseudoHeaders;
+    HasPseudoHeaders = true;
+}
+
+void
+MsH3pBiDirStream::RecordContentLength(
+    _In_ const MSH3_HEADER& Header
+    )
+{
+    uint64_t Value;
+    if (!MsH3pParseContentLength(Header.Value, Header.ValueLength, &Value) ||
+        (SectionContentLength != UINT64_MAX && SectionContentLength != Value)) {
+        SectionContentLengthInvalid = true; // Malformed, per RFC 9110 8.6
+        return;
+    }
+    SectionContentLength = Value;
+}
+
+//
+// Takes the content-length from a decoded message head, and indicates it to
+// the app before any DATA. Trailers (no pseudo-headers) and interim responses
+// don't declare the body length, and neither do the heads of responses that
+// never have a body (RFC 9110 6.4.1).
+//
+void
+MsH3pBiDirStream::CompleteContentLength()
+{
+    if (!SectionHasPseudoHeaders || ContentLength != UINT64_MAX) return;
+    const uint32_t Status = SectionPseudoHeaders.Status;
+    if (Status >= 100 && Status < 200) return;
+    if (SectionContentLengthInvalid) {
+        AbortReceive(H3ErrorMessageError, true);
+        return;
+    }
+    if (SectionContentLength == UINT64_MAX ||
+        SentHeadRequest || Status == 204 || Status == 304) return;
+    ContentLength = SectionContentLength;
+    MSH3_REQUEST_EVENT h3Event = {};
+    h3Event.Type = MSH3_REQUEST_EVENT_BODY_SIZE_HINT;
+    h3Event.BODY_SIZE_HINT.ContentLength = ContentLength;
+    Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
+}
+
+//
+// Aborts the receive side (and the send side too, for a malformed message,
+// per RFC 9114 4.1.2), and tells the app with a PEER_SEND_ABORTED event with
+// the local error code. Any further received data is dropped.
+//
+void
+MsH3pBiDirStream::AbortReceive(
+    _In_ H3ErrorCode ErrorCode,
+    _In_ bool AbortSend
+    )
+{
+    if (ReceiveAborted) return;
+    ReceiveAborted = true;
+    Complete = true;
+    if (ErrorCode == H3ErrorMessageError) {
+        printf("Malformed message, content-length %llu, body %llu\n",
+            (unsigned long long)ContentLength, (unsigned long long)ReceivedBodyLength);
+    }
+    (void)Shutdown(
+        ErrorCode,
+        AbortSend ?
+            QUIC_STREAM_SHUTDOWN_FLAG_ABORT_SEND | QUIC_STREAM_SHUTDOWN_FLAG_ABORT_RECEIVE :
+            QUIC_STREAM_SHUTDOWN_FLAG_ABORT_RECEIVE);
+    MSH3_REQUEST_EVENT h3Event = {};
+    h3Event.Type = MSH3_REQUEST_EVENT_PEER_SEND_ABORTED;
+    h3Event.PEER_SEND_ABORTED.ErrorCode = ErrorCode;
+    Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
+}
+
+void
+MsH3pBiDirStream::IndicateHeadersComplete()
+{
+    const size_t Count = SectionHeaders.size();
+    auto Headers =
+        (MSH3_HEADER*)HeaderArena.Alloc(
+            (Count ? Count : 1) * sizeof(MSH3_HEADER), alignof(MSH3_HEADER));
+    if (!Headers) {
+        printf("Header section too big, %zu headers\n", Count);
+        SectionHeaders.clear();
+        AbortReceive(H3ErrorExcessiveLoad, true);
+        return;
+    }
+    if (Count) memcpy(Headers, SectionHeaders.data(), Count * sizeof(MSH3_HEADER));
+    SectionHeaders.clear();
     MSH3_REQUEST_EVENT h3Event = {};
-    h3Event.Type = MSH3_REQUEST_EVENT_HEADER_RECEIVED;
-    h3Event.HEADER_RECEIVED.Header = &h;
+    h3Event.Type = MSH3_REQUEST_EVENT_HEADERS_COMPLETE;
+    h3Event.HEADERS_COMPLETE.HeaderCount = (uint32_t)Count;
+    h3Event.HEADERS_COMPLETE.Headers = Headers;
+    h3Event.HEADERS_COMPLETE.PseudoHeaders = SectionHasPseudoHeaders ? &SectionPseudoHeaders : nullptr;
+    PublishPseudoHeaders();
     Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
 }
 
+//
+// Indicates the headers collected in DecodeBuffer for the decoded section, one
+// HEADER_RECEIVED event each, with the decoder unlocked.
+//
+void
+MsH3pBiDirStream::IndicateDecodedHeaders()
+{
+    //
+    // Pseudo-headers are all recorded before the first indication, so the app
+    // sees the whole set from any of them.
+    //
+    MsH3pDecodedHeader Record;
+    for (uint32_t Offset = 0; Offset < DecodeLength; Offset = Record.ValueOffset + Record.ValueLength) {
+        memcpy(&Record, DecodeBuffer + Offset, sizeof(Record));
+        if (Record.Field == H3PseudoHeaderNone) continue;
+        RecordPseudoHeader(Record.Field, {
+            .Name = DecodeBuffer + Record.NameOffset,
+            .NameLength = Record.NameLength,
+            .Value = DecodeBuffer + Record.ValueOffset,
+            .ValueLength = Record.ValueLength });
+    }
+    PublishPseudoHeaders();
+
+    for (uint32_t Offset = 0; Offset < DecodeLength && !ReceiveAborted; ) {
+        memcpy(&Record, DecodeBuffer + Offset, sizeof(Record));
+        Offset = Record.ValueOffset + Record.ValueLength;
+        const MSH3_HEADER h {
+            .Name = DecodeBuffer + Record.NameOffset,
+            .NameLength = Record.NameLength,
+            .Value = DecodeBuffer + Record.ValueOffset,
+            .ValueLength = Record.ValueLength };
+        MSH3_REQUEST_EVENT h3Event = {};
+        h3Event.Type = MSH3_REQUEST_EVENT_HEADER_RECEIVED;
+        h3Event.HEADER_RECEIVED.Header = &h;
+        Callbacks((MSH3_REQUEST*)this, Context, &h3Event);
+    }
+    PublishPseudoHeaders(true);
+}
+
+//
+// MsH3pHeaderTemplate
+//
+
+bool
+MsH3pHeaderTemplate::Initialize(
+    _In_reads_(HeadersCount)
+        const MSH3_HEADER* Headers,
+    _In_ size_t HeadersCount
+    )
+{
+    const uint8_t SlotPlaceholder = 0x01; // Matches no static table value
+
+    size_t MaxLength = 0, BlockBound = 0;
+    for (size_t i = 0; i < HeadersCount; ++i) {
+        const auto& Header = Headers[i];
+        if (!Header.Name || Header.NameLength == 0 || (!Header.Value && Header.ValueLength != 0)) {
+            return false;
+        }
+        const size_t Length = Header.NameLength + (Header.Value ? Header.ValueLength : 1);
+        if (Length > UINT16_MAX) return false;
+        if (Length > MaxLength) MaxLength = Length;
+        BlockBound += Length + 2 * 6; // Plus worst case prefixed integers
+        if (MsH3pIsMethodHeader(Header)) { // For detecting HEAD requests when sent
+            if (Header.Value) {
+                Method = MsH3pParseMethod(Header.Value, Header.ValueLength);
+            } else {
+                MethodSlot = SlotCount;
+            }
+        }
+        if (!Header.Value) SlotCount++;
+    }
+    if (HeadersCount == 0 || BlockBound > UINT32_MAX) return false;
+
+    Block = new(std::nothrow) uint8_t[BlockBound];
+    Names = new(std::nothrow) uint8_t[BlockBound];
+    Slots = new(std::nothrow) Slot[SlotCount ? SlotCount : 1];
+    auto Scratch = new(std::nothrow) char[MaxLength];
+    if (!Block || !Names || !Slots || !Scratch) {
+        delete [] Scratch;
+        return false;
+    }
+
+    //
+    // A private encoder with a zero capacity dynamic table only ever produces
+    // static table references and literals, and no encoder stream output.
+    //
+    struct lsqpack_enc Encoder;
+    uint8_t TsuBuffer[LSQPACK_LONGEST_SDTC];
+    size_t TsuBufferLength = sizeof(TsuBuffer);
+    lsqpack_enc_preinit(&Encoder, MSH3_QPACK_LOG_CONTEXT);
+    bool Result = false;
+    if (lsqpack_enc_init(&Encoder, MSH3_QPACK_LOG_CONTEXT, 0, 0, 0, LSQPACK_ENC_OPT_STAGE_2, TsuBuffer, &TsuBufferLength) != 0 ||
+        lsqpack_enc_start_header(&Encoder, 0, 0) != 0) {
+        printf("lsqpack_enc_init failed\n");
+        goto Exit;
+    }
+
+    {
+    uint32_t SlotIndex = 0, NamesLength = 0;
+    for (size_t i = 0; i < HeadersCount; ++i) {
+        const auto& Header = Headers[i];
+        const bool IsSlot = Header.Value == nullptr;
+        lsxpack_header_t Field;
+        memset(&Field, 0, sizeof(Field));
+        memcpy(Scratch, Header.Name, Header.NameLength);
+        if (IsSlot) {
+            Scratch[Header.NameLength] = (char)SlotPlaceholder;
+        } else {
+            memcpy(Scratch + Header.NameLength, Header.Value, Header.ValueLength);
+        }
+        Field.buf = Scratch;
+        Field.name_len = (lsxpack_strlen_t)Header.NameLength;
+        Field.val_offset = (lsxpack_offset_t)Header.NameLength;
+        Field.val_len = (lsxpack_strlen_t)(IsSlot ? 1 : Header.ValueLength);
+
+        uint8_t EncoderBuffer[16];
+        size_t EncoderLength = sizeof(EncoderBuffer), FieldLength = BlockBound - BlockLength;
+        auto Status =
+            lsqpack_enc_encode(
+                &Encoder, EncoderBuffer, &EncoderLength, Block + BlockLength,
+                &FieldLength, &Field, LQEF_NO_INDEX);
+        if (Status != LQES_OK) {
+            printf("lsqpack_enc_encode failed, %d\n", Status);
+            goto Exit;
+        }
+        if (!IsSlot) {
+            BlockLength += (uint32_t)FieldLength;
+            continue;
+        }
+
+        auto& NewSlot = Slots[SlotIndex++];
+        NewSlot.BlockOffset = BlockLength;
+        NewSlot.NameOffset = NamesLength;
+        const uint8_t* Encoded = Block + BlockLength;
+        if (FieldLength > 2 &&
+            Encoded[FieldLength-2] == 1 && // Non-Huffman, length 1
+            Encoded[FieldLength-1] == SlotPlaceholder) {
+            // Keep the encoder's name representation (static name reference
+            // or literal name) and drop the placeholder value.
+            NewSlot.NameLength = (uint32_t)FieldLength - 2;
+            memcpy(Names + NamesLength, Encoded, NewSlot.NameLength);
+        } else {
+            // Literal field line with literal name (RFC 9204 section 4.5.6)
+            NewSlot.NameLength = H3WritePrefixedInt(0x20, 3, (uint32_t)Header.NameLength, Names + NamesLength);
+            memcpy(Names + NamesLength + NewSlot.NameLength, Header.Name, Header.NameLength);
+            NewSlot.NameLength += (uint32_t)Header.NameLength;
+        }
+        NamesLength += NewSlot.NameLength;
+    }
+    }
+
+    {
+    enum lsqpack_enc_header_flags HeaderFlags;
+    auto PrefixSize = lsqpack_enc_end_header(&Encoder, Prefix, sizeof(Prefix), &HeaderFlags);
+    if (PrefixSize < 0) {
+        printf("lsqpack_enc_end_header failed\n");
+        goto Exit;
+    }
+    PrefixLength = (uint32_t)PrefixSize;
+    }
+    Result = true;
+
+Exit:
+    lsqpack_enc_cleanup(&Encoder);
+    delete [] Scratch;
+    return Result;
+}
+
 //
 // MsH3pListener
 //
@@ -0,0 +1,357 @@
+/*++
+
+    Copyright (c) Microsoft Corporation.
+    Licensed under the MIT License.
+
+--*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Incremental parsing of HTTP/3 varints and frames (RFC 9114 7.1) for streams
+// whose data may be split at any byte, across buffers and receive events.
+// Only depends on the C runtime, so it can be tested on its own.
+//
+
+struct MsH3pVarIntReader {
+    uint64_t Value {0};
+    uint8_t Length {0};     // Encoded length, zero until the first byte is read
+    uint8_t ReadLength {0};
+
+    bool IsComplete() const { return Length != 0 && ReadLength == Length; }
+
+    void Reset() { Value = 0; Length = 0; ReadLength = 0; }
+
+    //
+    // Consumes bytes from [*Data, End) until the varint is complete. Returns
+    // true once it is, leaving *Data just past it.
+    //
+    bool
+    Feed(
+        const uint8_t** Data,
+        const uint8_t* End
+        )
+    {
+        if (Length == 0) {
+            if (*Data == End) return false;
+            Length = (uint8_t)(1 << (**Data >> 6));
+            Value = **Data & 0x3F;
+            ReadLength = 1;
+            ++*Data;
+        }
+        while (ReadLength < Length) {
+            if (*Data == End) return false;
+            Value = (Value << 8) | **Data;
+            ReadLength++;
+            ++*Data;
+        }
+        return true;
+    }
+};
+
+enum H3FrameReadResult {
+    H3FrameReadNeedMore,    // All the data was consumed, without completing a frame
+    H3FrameReadComplete,    // A frame is available in Type/Payload/PayloadLength
+    H3FrameReadError,       // A frame payload was bigger than MaxPayloadLength
+    H3FrameReadOutOfMemory, // A split frame payload couldn't be buffered
+};
+
+//
+// Frames of types that IsBuffered rejects (e.g. unknown and reserved types)
+// are skipped as they are read, whatever their length, and never returned.
+//
+struct MsH3pFrameReader {
+    const uint32_t MaxPayloadLength;    // Of the frames that are returned
+    bool (*const IsBuffered)(uint64_t Type); // All types if null
+
+    MsH3pVarIntReader TypeReader;
+    MsH3pVarIntReader LengthReader;
+    uint8_t* Buffer {nullptr};          // Only used for payloads split across reads
+    uint32_t BufferCapacity {0};
+    uint32_t BufferLength {0};
+    uint64_t SkipLength {0};            // Left of the payload being skipped
+    bool Skipping {false};
+    bool Delivered {false};             // The last frame was returned to the caller
+    bool Failed {false};
+    H3FrameReadResult FailedResult {H3FrameReadError};
+
+    // The frame, valid until the next call to Read
+    uint64_t Type {0};
+    const uint8_t* Payload {nullptr};
+    uint32_t PayloadLength {0};
+
+    MsH3pFrameReader(uint32_t MaxPayloadLength, bool (*IsBuffered)(uint64_t Type) = nullptr)
+        : MaxPayloadLength(MaxPayloadLength), IsBuffered(IsBuffered) { }
+    ~MsH3pFrameReader() { free(Buffer); }
+    MsH3pFrameReader(const MsH3pFrameReader&) = delete;
+    MsH3pFrameReader& operator=(const MsH3pFrameReader&) = delete;
+
+    //
+    // Reads (the rest of) the next frame from Data. Returns H3FrameReadComplete
+    // with *Consumed set to the bytes used, in which case the caller calls
+    // again with what's left. A payload that is entirely in Data is returned in
+    // place; otherwise it is copied until complete.
+    //
+    H3FrameReadResult
+    Read(
+        const uint8_t* Data,
+        uint32_t DataLength,
+        uint32_t* Consumed
+        )
+    {
+        if (Failed) {
+            *Consumed = DataLength;
+            return FailedResult;
+        }
+        if (Delivered) {
+            TypeReader.Reset();
+            LengthReader.Reset();
+            BufferLength = 0;
+            Payload = nullptr;
+            PayloadLength = 0;
+            Delivered = false;
+        }
+
+        const uint8_t* Cur = Data;
+        const uint8_t* End = Data + DataLength;
+        for (;;) {
+            if (!TypeReader.Feed(&Cur, End) || !LengthReader.Feed(&Cur, End)) {
+                *Consumed = DataLength;
+                return H3FrameReadNeedMore;
+            }
+            if (!IsBuffered || IsBuffered(TypeReader.Value)) break;
+            if (!Skipping) {
+                Skipping = true;
+                SkipLength = LengthReader.Value;
+            }
+            const uint64_t Available = (uint64_t)(End - Cur);
+            const uint64_t ToSkip = SkipLength < Available ? SkipLength : Available;
+            Cur += ToSkip;
+            SkipLength -= ToSkip;
+            if (SkipLength != 0) {
+                *Consumed = DataLength;
+                return H3FrameReadNeedMore;
+            }
+            Skipping = false;
+            TypeReader.Reset();
+            LengthReader.Reset();
+        }
+        if (LengthReader.Value > MaxPayloadLength) {
+            Failed = true;
+            *Consumed = DataLength;
+            return H3FrameReadError;
+        }
+
+        const uint32_t Needed = (uint32_t)LengthReader.Value;
+        const uint32_t Available = (uint32_t)(End - Cur);
+        if (BufferLength == 0 && Available >= Needed) {
+            Payload = Cur; // Common case: no copy
+            Cur += Needed;
+        } else {
+            if (BufferCapacity < Needed) {
+                auto NewBuffer = (uint8_t*)realloc(Buffer, Needed);
+                if (!NewBuffer) {
+                    Failed = true;
+                    FailedResult = H3FrameReadOutOfMemory;
+                    *Consumed = DataLength;
+                    return H3FrameReadOutOfMemory;
+                }
+                Buffer = NewBuffer;
+                BufferCapacity = Needed;
+            }
+            uint32_t ToCopy = Needed - BufferLength;
+            if (ToCopy > Available) ToCopy = Available;
+            if (ToCopy) memcpy(Buffer + BufferLength, Cur, ToCopy);
+            BufferLength += ToCopy;
+            Cur += ToCopy;
+            if (BufferLength < Needed) {
+                *Consumed = DataLength;
+                return H3FrameReadNeedMore;
+            }
+            Payload = Buffer;
+        }
+
+        Type = TypeReader.Value;
+        PayloadLength = Needed;
+        Delivered = true;
+        *Consumed = (uint32_t)(Cur - Data);
+        return H3FrameReadComplete;
+    }
+};
+
+//
+// Branch-light varint decoding for scanning many frame headers at once. The
+// encoded length comes straight from the two prefix bits, and when at least 8
+// bytes are readable the value is extracted from a single big-endian load with
+// a shift and a mask, whatever its length.
+//
+
+inline uint32_t MsH3pVarIntLength(uint8_t First) { return 1u << (First >> 6); }
+
+inline uint64_t
+MsH3pLoadBigEndian64(
+    const uint8_t* Data
+    )
+{
+    uint64_t Value;
+    memcpy(&Value, Data, sizeof(Value));
+#if defined(_MSC_VER)
+    return _byteswap_uint64(Value);
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return Value;
+#else
+    return __builtin_bswap64(Value);
+#endif
+}
+
+inline uint32_t
+MsH3pLoadBigEndian32(
+    const uint8_t* Data
+    )
+{
+    uint32_t Value;
+    memcpy(&Value, Data, sizeof(Value));
+#if defined(_MSC_VER)
+    return _byteswap_ulong(Value);
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return Value;
+#else
+    return __builtin_bswap32(Value);
+#endif
+}
+
+// Requires 8 readable bytes at Data.
+inline uint64_t
+MsH3pVarIntDecodeWide(
+    const uint8_t* Data,
+    uint32_t Length
+    )
+{
+    const uint32_t Bits = 8 * Length;
+    return (MsH3pLoadBigEndian64(Data) >> (64 - Bits)) & (~0ULL >> (66 - Bits));
+}
+
+inline uint64_t
+MsH3pVarIntDecodeNarrow(
+    const uint8_t* Data,
+    uint32_t Length
+    )
+{
+    uint64_t Value = Data[0] & 0x3F;
+    for (uint32_t i = 1; i < Length; ++i) {
+        Value = (Value << 8) | Data[i];
+    }
+    return Value;
+}
+
+//
+// Decodes one varint at *Offset, branching on its length. Used for short,
+// reassembled frame headers, and for SETTINGS payloads.
+//
+inline bool
+MsH3pVarIntDecode(
+    uint32_t BufferLength,
+    const uint8_t* const Buffer,
+    uint32_t* Offset,
+    uint64_t* Value
+    )
+{
+    if (BufferLength < sizeof(uint8_t) + *Offset) {
+        return false;
+    }
+    if (Buffer[*Offset] < 0x40) {
+        *Value = Buffer[*Offset];
+        *Offset += sizeof(uint8_t);
+    } else if (Buffer[*Offset] < 0x80) {
+        if (BufferLength < sizeof(uint16_t) + *Offset) {
+            return false;
+        }
+        *Value = ((uint64_t)(Buffer[*Offset] & 0x3fUL)) << 8;
+        *Value |= Buffer[*Offset + 1];
+        *Offset += sizeof(uint16_t);
+    } else if (Buffer[*Offset] < 0xc0) {
+        if (BufferLength < sizeof(uint32_t) + *Offset) {
+            return false;
+        }
+        *Value = MsH3pLoadBigEndian32(Buffer + *Offset) & 0x3fffffffUL;
+        *Offset += sizeof(uint32_t);
+    } else {
+        if (BufferLength < sizeof(uint64_t) + *Offset) {
+            return false;
+        }
+        *Value = MsH3pLoadBigEndian64(Buffer + *Offset) & 0x3fffffffffffffffULL;
+        *Offset += sizeof(uint64_t);
+    }
+    return true;
+}
+
+struct H3FrameRef {
+    uint64_t Type;
+    uint64_t Length;            // Of the payload, which may run past the buffer
+    uint32_t HeaderOffset;      // Of the frame's first byte
+    uint32_t PayloadOffset;
+};
+
+//
+// Finds the headers of consecutive frames in Buffer, starting at a frame
+// boundary at Offset, in one pass. Stops at MaxFrames, at a frame header that
+// isn't complete in the buffer, or after a frame whose payload runs past the
+// end of the buffer. Returns the number of frames found.
+//
+inline uint32_t
+MsH3pScanFrames(
+    const uint8_t* Buffer,
+    uint32_t Length,
+    uint32_t Offset,
+    H3FrameRef* Frames,
+    uint32_t MaxFrames
+    )
+{
+    uint32_t Count = 0;
+    while (Count < MaxFrames && Offset < Length) {
+        H3FrameRef& Frame = Frames[Count];
+        const uint8_t* Header = Buffer + Offset;
+        const uint32_t Remaining = Length - Offset;
+        uint32_t HeaderLength;
+        if (Remaining >= 8 && Header[0] < 0x40) {
+            //
+            // Common case: a one byte type (DATA or HEADERS), not at the end of
+            // the buffer. A single load covers the type and the whole length.
+            //
+            const uint64_t Load = MsH3pLoadBigEndian64(Header);
+            const uint32_t LengthLength = MsH3pVarIntLength((uint8_t)(Load >> 48));
+            if (LengthLength > 4) {
+                if (Remaining < 9) break;
+                Frame.Length = MsH3pVarIntDecodeWide(Header + 1, 8);
+            } else {
+                const uint32_t Bits = 8 * LengthLength;
+                Frame.Length = ((Load << 8) >> (64 - Bits)) & (~0ULL >> (66 - Bits));
+            }
+            Frame.Type = Header[0];
+            HeaderLength = 1 + LengthLength;
+        } else {
+            const uint32_t TypeLength = MsH3pVarIntLength(Header[0]);
+            if (TypeLength >= Remaining) break; // Not even the first byte of the length
+            const uint32_t LengthLength = MsH3pVarIntLength(Header[TypeLength]);
+            HeaderLength = TypeLength + LengthLength;
+            if (HeaderLength > Remaining) break;
+            if (Remaining >= TypeLength + 8) {
+                Frame.Type = MsH3pVarIntDecodeWide(Header, TypeLength);
+                Frame.Length = MsH3pVarIntDecodeWide(Header + TypeLength, LengthLength);
+            } else {
+                Frame.Type = MsH3pVarIntDecodeNarrow(Header, TypeLength);
+                Frame.Length = MsH3pVarIntDecodeNarrow(Header + TypeLength, LengthLength);
+            }
+        }
+        Count++;
+        Frame.HeaderOffset = Offset;
+        Frame.PayloadOffset = Offset + HeaderLength;
+        if (Frame.Length > Length - Frame.PayloadOffset) break;
+        Offset = Frame.PayloadOffset + (uint32_t)Frame.Length;
+    }
+    return Count;
+}
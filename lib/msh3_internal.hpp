@@ -22,16 +22,25 @@
 #include <lsxpack_header.h>
 #include <stdio.h>
 #include <vector>
+#include <deque>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <utility>
+#include <cstddef>
+#ifndef _WIN32
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#endif
 
 #ifdef _WIN32
 #pragma warning(pop)
 #endif
 
 #include "msh3.h"
+#include "msh3_frame.hpp"
 #define MSH3_VERSION_ONLY 1
 #include "msh3.ver"
 
@@ -85,26 +94,31 @@ enum H3SettingsType {
 };
 
 // Contiguous buffer for (non-null-terminated) header name and value strings.
-struct H3HeadingPair : public lsxpack_header_t {
-    char Buffer[512] = {0};
-    H3HeadingPair() { memset(this, 0, sizeof(lsxpack_header_t)); }
-    bool Set(const MSH3_HEADER* Header) {
-        if (Header->NameLength + Header->ValueLength > sizeof(Buffer)) return false;
-        buf = Buffer;
-        name_offset = 0;
-        name_len = (lsxpack_strlen_t)Header->NameLength;
-        val_offset = name_len;
-        val_len = (lsxpack_strlen_t)Header->ValueLength;
-        memcpy(Buffer, Header->Name, name_len);
-        memcpy(Buffer+name_len, Header->Value, val_len);
-        return true;
+// Points an lsxpack field at a header's name and value for encoding. The
+// app's memory is used directly when the value immediately follows the name;
+// otherwise both are copied to Scratch, which must fit NameLength + ValueLength.
+inline bool
+H3SetEncodeField(
+    _Out_ lsxpack_header_t* Field,
+    _In_ const MSH3_HEADER* Header,
+    _In_opt_ char* Scratch
+    )
+{
+    if (Header->NameLength > LSXPACK_MAX_STRLEN || Header->ValueLength > LSXPACK_MAX_STRLEN) return false;
+    memset(Field, 0, sizeof(*Field));
+    if (Header->Value == Header->Name + Header->NameLength) {
+        Field->buf = (char*)Header->Name; // Already contiguous, so no copy
+    } else {
+        if (!Scratch) return false;
+        memcpy(Scratch, Header->Name, Header->NameLength);
+        memcpy(Scratch + Header->NameLength, Header->Value, Header->ValueLength);
+        Field->buf = Scratch;
     }
-};
-
-struct H3Headers {
-    H3HeadingPair* Pairs;
-    uint32_t PairCount;
-};
+    Field->name_len = (lsxpack_strlen_t)Header->NameLength;
+    Field->val_offset = (lsxpack_offset_t)Header->NameLength;
+    Field->val_len = (lsxpack_strlen_t)Header->ValueLength;
+    return true;
+}
 
 struct H3Settings {
     H3SettingsType Type;
@@ -127,11 +141,49 @@ enum H3FrameType {
     H3FrameSettings     = 4,
     H3FramePushPromise  = 5,
     H3FrameGoaway       = 7,
+    H3FrameMaxPushId    = 0xD,
     H3FrameUnknown      = 0xFF
 };
 
+// https://datatracker.ietf.org/doc/html/rfc9114#section-8.1
+enum H3ErrorCode {
+    H3ErrorNoError              = 0x100,
+    H3ErrorGeneralProtocolError = 0x101,
+    H3ErrorInternalError        = 0x102,
+    H3ErrorFrameError           = 0x106,
+    H3ErrorExcessiveLoad        = 0x107,
+    H3ErrorMessageError         = 0x10E,
+    H3ErrorQPackDecompressionFailed = 0x200,
+};
+
+// QPACK static table entries with pseudo-header names, https://www.rfc-editor.org/rfc/rfc9204#appendix-A
+enum H3StaticIndex {
+    H3StaticAuthority       = 0,
+    H3StaticPath            = 1,
+    H3StaticContentLength   = 4,    // content-length 0
+    H3StaticMethodFirst     = 15,   // :method CONNECT ... PUT
+    H3StaticMethodLast      = 21,
+    H3StaticSchemeFirst     = 22,   // :scheme http, https
+    H3StaticSchemeLast      = 23,
+    H3StaticStatusFirst     = 24,   // :status 103 ... 503
+    H3StaticStatusLast      = 28,
+    H3StaticStatus2First    = 63,   // :status 100 ... 500
+    H3StaticStatus2Last     = 71,
+};
+
+enum H3PseudoHeader {
+    H3PseudoHeaderNone,
+    H3PseudoHeaderMethod,
+    H3PseudoHeaderStatus,
+    H3PseudoHeaderPath,
+    H3PseudoHeaderAuthority,
+    H3PseudoHeaderScheme,
+};
+
 #define H3_RFC_DEFAULT_HEADER_TABLE_SIZE    0
 #define H3_RFC_DEFAULT_QPACK_BLOCKED_STREAM 0
+#define MSH3_CONTROL_FRAME_MAX_PAYLOAD      0x4000 // Bigger SETTINGS, GOAWAY, etc. close the connection
+#define H3_FIELD_LINE_OVERHEAD              32 // Added to each header, for SETTINGS_MAX_FIELD_SECTION_SIZE
 
 // Helper functions to get QPACK settings based on configuration
 inline uint32_t GetQPackMaxTableCapacity(bool DynamicQPackEnabled) {
@@ -142,61 +194,16 @@ inline uint32_t GetQPackBlockedStreams(bool DynamicQPackEnabled) {
     return DynamicQPackEnabled ? 100 : 0;   // Allow up to 100 blocked streams
 }
 
-// Copied from QuicVanIntDecode and changed to uint32_t offset/length
-inline
-_Success_(return != FALSE)
-BOOLEAN
-MsH3pVarIntDecode(
-    _In_ uint32_t BufferLength,
-    _In_reads_bytes_(BufferLength)
-        const uint8_t * const Buffer,
-    _Inout_
-    _Deref_in_range_(0, BufferLength)
-    _Deref_out_range_(0, BufferLength)
-        uint32_t* Offset,
-    _Out_ QUIC_VAR_INT* Value
-    )
-{
-    if (BufferLength < sizeof(uint8_t) + *Offset) {
-        return FALSE;
-    }
-    if (Buffer[*Offset] < 0x40) {
-        *Value = Buffer[*Offset];
-        CXPLAT_ANALYSIS_ASSERT(*Value < 0x100ULL);
-        *Offset += sizeof(uint8_t);
-    } else if (Buffer[*Offset] < 0x80) {
-        if (BufferLength < sizeof(uint16_t) + *Offset) {
-            return FALSE;
-        }
-        *Value = ((uint64_t)(Buffer[*Offset] & 0x3fUL)) << 8;
-        *Value |= Buffer[*Offset + 1];
-        CXPLAT_ANALYSIS_ASSERT(*Value < 0x10000ULL);
-        *Offset += sizeof(uint16_t);
-    } else if (Buffer[*Offset] < 0xc0) {
-        if (BufferLength < sizeof(uint32_t) + *Offset) {
-            return FALSE;
-        }
-        uint32_t v;
-        memcpy(&v, Buffer + *Offset, sizeof(uint32_t));
-        *Value = CxPlatByteSwapUint32(v) & 0x3fffffffUL;
-        CXPLAT_ANALYSIS_ASSERT(*Value < 0x100000000ULL);
-        *Offset += sizeof(uint32_t);
-    } else {
-        if (BufferLength < sizeof(uint64_t) + *Offset) {
-            return FALSE;
-        }
-        uint64_t v;
-        memcpy(&v, Buffer + *Offset, sizeof(uint64_t));
-        *Value = CxPlatByteSwapUint64(v) & 0x3fffffffffffffffULL;
-        *Offset += sizeof(uint64_t);
-    }
-    return TRUE;
+// Control stream frames that are read; any others (e.g. grease) are skipped
+inline bool MsH3pIsControlFrameType(uint64_t Type) {
+    return Type == H3FrameSettings || Type == H3FrameGoaway ||
+        Type == H3FrameCancelPush || Type == H3FrameMaxPushId;
 }
 
 inline bool
 H3WriteFrameHeader(
     _In_ uint8_t Type,
-    _In_ uint32_t Length,
+    _In_ QUIC_VAR_INT Length,
     _Inout_ uint32_t* Offset,
     _In_ uint32_t BufferLength,
     _Out_writes_to_(BufferLength, *Offset)
@@ -252,6 +259,145 @@ H3WriteSettingsFrame(
     return true;
 }
 
+// QPACK prefixed integer (RFC 9204 section 4.1.1). The bits above the prefix
+// in the first byte are taken from Flags.
+inline uint32_t
+H3WritePrefixedInt(
+    _In_ uint8_t Flags,
+    _In_ uint8_t PrefixBits,
+    _In_ uint32_t Value,
+    _Out_writes_(6) uint8_t* Buffer
+    )
+{
+    const uint8_t MaxPrefix = (uint8_t)((1 << PrefixBits) - 1);
+    if (Value < MaxPrefix) {
+        Buffer[0] = Flags | (uint8_t)Value;
+        return 1;
+    }
+    Buffer[0] = Flags | MaxPrefix;
+    uint32_t Length = 1;
+    Value -= MaxPrefix;
+    while (Value >= 0x80) {
+        Buffer[Length++] = 0x80 | (uint8_t)(Value & 0x7F);
+        Value >>= 7;
+    }
+    Buffer[Length++] = (uint8_t)Value;
+    return Length;
+}
+
+// Identifies a pseudo-header by the static table entry QPACK decoded its name
+// from, only comparing names that were sent as literals or dynamic entries.
+inline H3PseudoHeader
+MsH3pGetPseudoHeader(
+    _In_ const struct lsxpack_header* Header
+    )
+{
+    if (Header->flags & LSXPACK_QPACK_IDX) {
+        const uint8_t Index = Header->qpack_index;
+        if (Index == H3StaticAuthority) return H3PseudoHeaderAuthority;
+        if (Index == H3StaticPath) return H3PseudoHeaderPath;
+        if (Index >= H3StaticMethodFirst && Index <= H3StaticMethodLast) return H3PseudoHeaderMethod;
+        if (Index >= H3StaticSchemeFirst && Index <= H3StaticSchemeLast) return H3PseudoHeaderScheme;
+        if ((Index >= H3StaticStatusFirst && Index <= H3StaticStatusLast) ||
+            (Index >= H3StaticStatus2First && Index <= H3StaticStatus2Last)) return H3PseudoHeaderStatus;
+        return H3PseudoHeaderNone;
+    }
+    const char* Name = Header->buf + Header->name_offset;
+    if (Header->name_len < 5 || Name[0] != ':') return H3PseudoHeaderNone;
+    switch (Header->name_len) {
+    case 5: return memcmp(Name, ":path", 5) == 0 ? H3PseudoHeaderPath : H3PseudoHeaderNone;
+    case 7:
+        if (memcmp(Name, ":method", 7) == 0) return H3PseudoHeaderMethod;
+        if (memcmp(Name, ":status", 7) == 0) return H3PseudoHeaderStatus;
+        if (memcmp(Name, ":scheme", 7) == 0) return H3PseudoHeaderScheme;
+        return H3PseudoHeaderNone;
+    case 10: return memcmp(Name, ":authority", 10) == 0 ? H3PseudoHeaderAuthority : H3PseudoHeaderNone;
+    default: return H3PseudoHeaderNone;
+    }
+}
+
+inline MSH3_METHOD
+MsH3pParseMethod(
+    _In_reads_(Length) const char* Value,
+    _In_ size_t Length
+    )
+{
+    switch (Length) {
+    case 3:
+        if (memcmp(Value, "GET", 3) == 0) return MSH3_METHOD_GET;
+        if (memcmp(Value, "PUT", 3) == 0) return MSH3_METHOD_PUT;
+        break;
+    case 4:
+        if (memcmp(Value, "POST", 4) == 0) return MSH3_METHOD_POST;
+        if (memcmp(Value, "HEAD", 4) == 0) return MSH3_METHOD_HEAD;
+        break;
+    case 5:
+        if (memcmp(Value, "PATCH", 5) == 0) return MSH3_METHOD_PATCH;
+        if (memcmp(Value, "TRACE", 5) == 0) return MSH3_METHOD_TRACE;
+        break;
+    case 6:
+        if (memcmp(Value, "DELETE", 6) == 0) return MSH3_METHOD_DELETE;
+        break;
+    case 7:
+        if (memcmp(Value, "OPTIONS", 7) == 0) return MSH3_METHOD_OPTIONS;
+        if (memcmp(Value, "CONNECT", 7) == 0) return MSH3_METHOD_CONNECT;
+        break;
+    }
+    return MSH3_METHOD_OTHER;
+}
+
+inline bool
+MsH3pIsMethodHeader(
+    _In_ const MSH3_HEADER& Header
+    )
+{
+    return Header.NameLength == 7 && memcmp(Header.Name, ":method", 7) == 0;
+}
+
+// Returns 0 unless the value is exactly three digits (RFC 9110 15).
+inline uint32_t
+MsH3pParseStatus(
+    _In_reads_(Length) const char* Value,
+    _In_ size_t Length
+    )
+{
+    if (Length != 3) return 0;
+    uint32_t Status = 0;
+    for (size_t i = 0; i < 3; ++i) {
+        if (Value[i] < '0' || Value[i] > '9') return 0;
+        Status = Status * 10 + (uint32_t)(Value[i] - '0');
+    }
+    return Status;
+}
+
+inline bool
+MsH3pIsContentLength(
+    _In_ const struct lsxpack_header* Header
+    )
+{
+    if (Header->flags & LSXPACK_QPACK_IDX) return Header->qpack_index == H3StaticContentLength;
+    return Header->name_len == 14 && memcmp(Header->buf + Header->name_offset, "content-length", 14) == 0;
+}
+
+// Returns false unless the value is only digits, and fits in a varint.
+inline bool
+MsH3pParseContentLength(
+    _In_reads_(Length) const char* Value,
+    _In_ size_t Length,
+    _Out_ uint64_t* ContentLength
+    )
+{
+    if (Length == 0 || Length > 19) return false;
+    uint64_t Result = 0;
+    for (size_t i = 0; i < Length; ++i) {
+        if (Value[i] < '0' || Value[i] > '9') return false;
+        Result = Result * 10 + (uint64_t)(Value[i] - '0');
+    }
+    if (Result > QUIC_UINT62_MAX) return false;
+    *ContentLength = Result;
+    return true;
+}
+
 inline QUIC_STREAM_OPEN_FLAGS ToQuicOpenFlags(MSH3_REQUEST_FLAGS Flags) {
     return Flags & MSH3_REQUEST_FLAG_ALLOW_0_RTT ? QUIC_STREAM_OPEN_FLAG_0_RTT : QUIC_STREAM_OPEN_FLAG_NONE;
 }
@@ -263,6 +409,9 @@ inline QUIC_SEND_FLAGS ToQuicSendFlags(MSH3_REQUEST_SEND_FLAGS Flags) {
     }
     if (Flags & MSH3_REQUEST_SEND_FLAG_FIN) {
         QuicFlags |= QUIC_SEND_FLAG_START | QUIC_SEND_FLAG_FIN;
+        if (Flags & MSH3_REQUEST_SEND_FLAG_DELAY_SEND) {
+            QuicFlags |= QUIC_SEND_FLAG_DELAY_SEND; // The stream is already started at open
+        }
     } else if (Flags & MSH3_REQUEST_SEND_FLAG_DELAY_SEND) {
         QuicFlags |= QUIC_SEND_FLAG_DELAY_SEND; // TODO - Add support for a _START_DELAYED flag in MsQuic?
     } else {
@@ -286,9 +435,433 @@ inline QUIC_STREAM_SHUTDOWN_FLAGS ToQuicShutdownFlags(MSH3_REQUEST_SHUTDOWN_FLAG
     return QuicFlags;
 }
 
+// Fixed size block allocator backed by a bounded free list. Blocks are handed
+// out from the free list when possible and fall back to the heap otherwise. On
+// free, blocks are kept for reuse until MaxDepth is reached. Allocations and
+// frees may happen on different threads (app vs MsQuic worker), so the list is
+// protected by a lock.
+struct MsH3pPool {
+    struct Entry { Entry* Next; };
+
+    const uint32_t EntrySize;
+    const uint32_t MaxDepth;
+
+    std::mutex Lock;
+    Entry* FreeList {nullptr};
+    uint32_t Depth {0};
+
+    // Statistics
+    uint64_t AllocCount {0};        // Total number of allocations
+    uint64_t HeapAllocCount {0};    // Allocations not satisfied by the free list
+    uint64_t HeapFreeCount {0};     // Frees that went back to the heap (list full)
+    uint32_t InUseCount {0};        // Currently outstanding blocks
+
+    MsH3pPool(uint32_t EntrySize, uint32_t MaxDepth)
+        : EntrySize(EntrySize < sizeof(Entry) ? (uint32_t)sizeof(Entry) : EntrySize),
+          MaxDepth(MaxDepth) { }
+
+    ~MsH3pPool() {
+        while (FreeList) {
+            auto Next = FreeList->Next;
+            free(FreeList);
+            FreeList = Next;
+        }
+    }
+
+    void* Alloc() {
+        {
+            std::lock_guard Guard{Lock};
+            ++AllocCount;
+            ++InUseCount;
+            if (FreeList) {
+                auto Block = FreeList;
+                FreeList = Block->Next;
+                --Depth;
+                return Block;
+            }
+            ++HeapAllocCount;
+        }
+        auto Block = malloc(EntrySize);
+        if (!Block) {
+            std::lock_guard Guard{Lock};
+            --InUseCount;
+        }
+        return Block;
+    }
+
+    void Free(_In_ void* Block) {
+        {
+            std::lock_guard Guard{Lock};
+            --InUseCount;
+            if (Depth < MaxDepth) {
+                auto Head = (Entry*)Block;
+                Head->Next = FreeList;
+                FreeList = Head;
+                ++Depth;
+                return;
+            }
+            ++HeapFreeCount;
+        }
+        free(Block);
+    }
+
+    void GetStatistics(_Out_ MSH3_POOL_STATISTICS* Stats) {
+        std::lock_guard Guard{Lock};
+        Stats->AllocCount = AllocCount;
+        Stats->HeapAllocCount = HeapAllocCount;
+        Stats->HeapFreeCount = HeapFreeCount;
+        Stats->InUseCount = InUseCount;
+        Stats->CachedCount = Depth;
+    }
+
+    template<typename T, typename... Args>
+    T* New(Args&&... args) {
+        static_assert(alignof(T) <= alignof(std::max_align_t));
+        if (sizeof(T) > EntrySize) return nullptr;
+        auto Block = Alloc();
+        return Block ? new(Block) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    template<typename T>
+    void Delete(_In_opt_ T* Object) {
+        if (Object) {
+            Object->~T();
+            Free(Object);
+        }
+    }
+};
+
+#define MSH3_APP_SEND_POOL_MAX_DEPTH 256 // Max cached send contexts per connection
+#define MSH3_SEND_BUFFER_SIZE 4096          // Max size of a library-side copy of send data
+#define MSH3_SEND_BUFFER_POOL_MAX_DEPTH 64  // Max cached send data copies per connection
+
+// A header list pre-encoded with only the QPACK static table, so the result
+// doesn't depend on any connection's state and can be shared by any number of
+// requests. Headers with a NULL value are slots; only their (encoded) names are
+// stored, and the value is filled in on each send.
+struct MsH3pHeaderTemplate {
+    struct Slot {
+        uint32_t BlockOffset;   // Where the slot's field line belongs in Block
+        uint32_t NameOffset;    // Offset of the encoded name in Names
+        uint32_t NameLength;
+    };
+
+    std::atomic_uint32_t RefCount {1};
+    uint8_t Prefix[8];          // Encoded field section prefix
+    uint32_t PrefixLength {0};
+    uint8_t* Block {nullptr};   // Encoded field lines, minus the slots
+    uint32_t BlockLength {0};
+    uint8_t* Names {nullptr};
+    Slot* Slots {nullptr};
+    uint32_t SlotCount {0};
+    MSH3_METHOD Method {MSH3_METHOD_NONE}; // Of a fixed :method header
+    uint32_t MethodSlot {UINT32_MAX};       // If :method is a slot instead
+
+    ~MsH3pHeaderTemplate() {
+        delete [] Block;
+        delete [] Names;
+        delete [] Slots;
+    }
+
+    bool
+    Initialize(
+        _In_reads_(HeadersCount)
+            const MSH3_HEADER* Headers,
+        _In_ size_t HeadersCount
+        );
+
+    void AddRef() { RefCount.fetch_add(1); }
+    void Release() { if (RefCount.fetch_sub(1) == 1) delete this; }
+};
+
+struct MsH3pSharedBuffer {
+    std::atomic_uint32_t RefCount {1};
+    uint32_t Length;
+    uint8_t* Buffer;
+
+    MsH3pSharedBuffer(_In_ uint32_t Length) :
+        Length(Length), Buffer(new(std::nothrow) uint8_t[Length]) { }
+    ~MsH3pSharedBuffer() { delete [] Buffer; }
+
+    void AddRef() { RefCount.fetch_add(1); }
+    void Release() { if (RefCount.fetch_sub(1) == 1) delete this; }
+};
+
+#define MSH3_SEND_COMPLETE_BATCH_SIZE 32 // Max completions reported in one batch event
+#define MSH3_COALESCE_BUFFER_SIZE 4096 // Max data aggregated from coalesced writes
+
+#define MSH3_FILE_SEND_CHUNK_SIZE       0x4000  // Size of each read from a file
+#define MSH3_FILE_SEND_DEFAULT_IN_FLIGHT 0x10000 // Until MsQuic indicates the ideal send size
+
+struct MsH3pFileSend {             // Protected by the stream's FileSendLock
+    MSH3_FILE File;
+    uint64_t Offset;
+    uint64_t LengthLeft;            // Not yet read from the file
+    uint32_t ChunksInFlight {0};    // Sent but not yet completed
+    bool Fin;
+    bool Canceled {false};          // Either a read or send failed
+    bool Pumping {false};           // A chunk is being read and sent, without the lock
+    bool Started {false};           // A chunk was handed to MsQuic
+    void* AppContext;
+    std::vector<MsH3pSharedBuffer*> FreeChunks;
+
+    MsH3pFileSend(
+        _In_ MSH3_FILE File,
+        _In_ uint64_t Offset,
+        _In_ uint64_t Length,
+        _In_ bool Fin,
+        _In_opt_ void* AppContext
+        ) : File(File), Offset(Offset), LengthLeft(Length), Fin(Fin), AppContext(AppContext) { }
+    ~MsH3pFileSend() {
+        for (auto Chunk : FreeChunks) Chunk->Release();
+    }
+};
+
+#define MSH3_ENCODE_BUFFER_POOL_SIZE 1024     // Size of pooled encode buffers, including the header
+#define MSH3_ENCODE_BUFFER_POOL_MAX_DEPTH 32  // Max cached encode buffers per connection
+
+// Upper bound on the QPACK encoded size of a header list, for either the
+// header block or the encoder stream instructions it generates.
+inline size_t
+H3EncodedHeadersBound(
+    _In_reads_(HeadersCount)
+        const MSH3_HEADER* Headers,
+    _In_ size_t HeadersCount
+    )
+{
+    size_t Bound = 16; // Section prefix and table capacity instruction slack
+    for (size_t i = 0; i < HeadersCount; ++i) {
+        Bound += Headers[i].NameLength + Headers[i].ValueLength + 12; // Plus worst case prefixed integers
+    }
+    return Bound;
+}
+
+// Encoded header output, from the connection's pool when small enough and
+// otherwise from the heap, that is held until its send completes.
+struct MsH3pEncodeBuffer {
+    MsH3pPool* Pool;        // Null if allocated from the heap
+    size_t Capacity;
+    QUIC_BUFFER Buffer;
+
+    uint8_t* Data() { return (uint8_t*)(this + 1); }
+
+    static MsH3pEncodeBuffer*
+    Alloc(
+        _In_ MsH3pPool& Pool,
+        _In_ size_t Capacity
+        )
+    {
+        if (Capacity > UINT32_MAX - sizeof(MsH3pEncodeBuffer)) return nullptr;
+        const bool Pooled = sizeof(MsH3pEncodeBuffer) + Capacity <= Pool.EntrySize;
+        auto This =
+            (MsH3pEncodeBuffer*)(Pooled ? Pool.Alloc() : malloc(sizeof(MsH3pEncodeBuffer) + Capacity));
+        if (!This) return nullptr;
+        This->Pool = Pooled ? &Pool : nullptr;
+        This->Capacity = Pooled ? Pool.EntrySize - sizeof(MsH3pEncodeBuffer) : Capacity;
+        This->Buffer.Length = 0;
+        This->Buffer.Buffer = This->Data();
+        return This;
+    }
+
+    static void
+    Free(
+        _In_opt_ MsH3pEncodeBuffer* This
+        )
+    {
+        if (!This) return;
+        if (This->Pool) {
+            This->Pool->Free(This);
+        } else {
+            free(This);
+        }
+    }
+};
+
+#define MSH3_DECODE_BUFFER_POOL_SIZE 4096         // Decode space for the common header
+#define MSH3_DECODE_BUFFER_POOL_MAX_DEPTH 16     // Max cached decode buffers per connection
+#define MSH3_DEFAULT_MAX_FIELD_SECTION_SIZE 0x10000 // Advertised unless configured
+
+//
+// Precedes each header decoded into a stream's DecodeBuffer. Without
+// HEADERS_COMPLETE, a section's headers are collected there while the decoder
+// is locked, and only indicated to the app once it's unlocked.
+//
+struct MsH3pDecodedHeader {
+    uint32_t NameOffset;
+    uint32_t NameLength;
+    uint32_t ValueOffset;
+    uint32_t ValueLength;
+    H3PseudoHeader Field;
+};
+
+#define MSH3_HEADER_ARENA_CHUNK_SIZE 2048     // Default size of each header arena allocation
+#define MSH3_HEADER_ARENA_MAX_SIZE 0x40000    // Max decoded header data kept per request
+
+//
+// Bump allocator for decoded header sections that stay valid until the
+// request is closed. Everything is freed at once with the arena.
+//
+struct MsH3pHeaderArena {
+    struct Chunk {
+        Chunk* Next;
+        size_t Capacity;
+        size_t Used;
+        char* Data() { return (char*)(this + 1); }
+    };
+    Chunk* Head {nullptr};  // Current chunk, newest first
+    size_t TotalSize {0};
+
+    ~MsH3pHeaderArena() {
+        while (Head) {
+            auto Next = Head->Next;
+            free(Head);
+            Head = Next;
+        }
+    }
+
+    void*
+    Alloc(
+        _In_ size_t Length,
+        _In_ size_t Alignment = 1
+        )
+    {
+        if (Head) {
+            size_t Offset = (Head->Used + Alignment - 1) & ~(Alignment - 1);
+            if (Offset + Length <= Head->Capacity) {
+                Head->Used = Offset + Length;
+                return Head->Data() + Offset;
+            }
+        }
+        size_t Capacity = Length > MSH3_HEADER_ARENA_CHUNK_SIZE ? Length : MSH3_HEADER_ARENA_CHUNK_SIZE;
+        if (TotalSize + Capacity > MSH3_HEADER_ARENA_MAX_SIZE) return nullptr;
+        auto New = (Chunk*)malloc(sizeof(Chunk) + Capacity);
+        if (!New) return nullptr;
+        New->Next = Head;
+        New->Capacity = Capacity;
+        New->Used = Length;
+        Head = New;
+        TotalSize += Capacity;
+        return New->Data();
+    }
+
+    //
+    // Grows the most recent allocation in place if possible.
+    //
+    bool
+    Extend(
+        _In_ void* Last,
+        _In_ size_t Length
+        )
+    {
+        if (!Head || (char*)Last < Head->Data() ||
+            (char*)Last > Head->Data() + Head->Used) return false;
+        size_t Offset = (size_t)((char*)Last - Head->Data());
+        if (Offset + Length > Head->Capacity) return false;
+        Head->Used = Offset + Length;
+        return true;
+    }
+
+    //
+    // Returns the unused tail of the most recent allocation.
+    //
+    void
+    Trim(
+        _In_ void* Last,
+        _In_ size_t Used
+        )
+    {
+        if (Head && (char*)Last >= Head->Data() && (char*)Last <= Head->Data() + Head->Used) {
+            Head->Used = (size_t)((char*)Last - Head->Data()) + Used;
+        }
+    }
+};
+
+#define MSH3_APP_SEND_INLINE_BUFFERS 8 // Buffers that fit without a separate allocation
+#define MSH3_PARKED_RECV_BUFFERS 4     // MsQuic indicates at most 3 buffers per receive
+#define MSH3_RECV_SLICES_MAX 16        // DATA payload slices per vectored receive indication
+#define MSH3_SCAN_FRAMES_MAX 8         // Frame headers decoded ahead per scan of a receive buffer
+
+enum MsH3pSendKind : uint8_t {
+    MsH3pSendApp,               // Made by the app
+    MsH3pSendFileChunk,         // Internal chunk of a file send
+    MsH3pSendCoalesced,         // Internal flush of coalesced writes
+};
+
+struct MsH3pAppSend {
+    void* AppContext;
+    MsH3pHeaderTemplate* Template {nullptr}; // Referenced until the send completes
+    MsH3pSharedBuffer* SharedBuffer {nullptr}; // Referenced until the send completes
+    MsH3pPool* CopyPool {nullptr};
+    void* CopyBuffer {nullptr};         // Library-side copy of the app's data
+    uint64_t SendLength {0};            // Total bytes, counted against the stream's watermarks
+    MsH3pEncodeBuffer* HeadersBlock {nullptr}; // Header block too big for the stream's inline buffer
+    bool IndicateComplete {true};       // Whether SEND_COMPLETE is indicated to the app
+    MsH3pSendKind Kind {MsH3pSendApp};
+    uint8_t FrameHeaderBuffer[16];
+    QUIC_BUFFER* Buffers {InlineBuffers};
+    uint32_t BufferCount {0};
+    QUIC_BUFFER InlineBuffers[MSH3_APP_SEND_INLINE_BUFFERS];
+    MsH3pAppSend(_In_opt_ void* AppContext) : AppContext(AppContext) { }
+    ~MsH3pAppSend() {
+        if (Buffers != InlineBuffers) delete [] Buffers;
+        if (Template) Template->Release();
+        if (SharedBuffer) SharedBuffer->Release();
+        if (CopyBuffer) CopyPool->Free(CopyBuffer);
+        MsH3pEncodeBuffer::Free(HeadersBlock);
+    }
+    bool Reserve(
+        _In_ uint32_t Count
+        )
+    {
+        if (Count > ARRAYSIZE(InlineBuffers)) {
+            Buffers = new(std::nothrow) QUIC_BUFFER[Count];
+        }
+        return Buffers != nullptr;
+    }
+    void SetHeaders(
+        _In_reads_(3) const QUIC_BUFFER* HeadersFrame
+        )
+    {
+        memcpy(Buffers, HeadersFrame, 3 * sizeof(QUIC_BUFFER));
+        BufferCount = 3;
+    }
+    bool SetData(
+        _In_reads_(DataBufferCount) const MSH3_BUFFER* DataBuffers,
+        _In_ uint32_t DataBufferCount,
+        _In_ bool WriteFrameHeader,
+        _In_ QUIC_VAR_INT FrameLength
+        )
+    {
+        if (WriteFrameHeader) {
+            auto FrameHeader = &Buffers[BufferCount++];
+            FrameHeader->Length = 0;
+            FrameHeader->Buffer = FrameHeaderBuffer;
+            if (!H3WriteFrameHeader(H3FrameData, FrameLength, &FrameHeader->Length, sizeof(FrameHeaderBuffer), FrameHeaderBuffer)) {
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < DataBufferCount; ++i) {
+            if (DataBuffers[i].Length == 0) continue;
+            Buffers[BufferCount].Length = DataBuffers[i].Length;
+            Buffers[BufferCount].Buffer = (uint8_t*)DataBuffers[i].Buffer;
+            BufferCount++;
+        }
+        return true;
+    }
+};
+
 struct MsH3pConfiguration : public MsQuicConfiguration {
     bool DatagramEnabled {false};
     bool DynamicQPackEnabled {false};
+    uint32_t SendBufferingThreshold {0};
+    bool SendCompleteBatchEnabled {false};
+    bool ReceiveVectoredEnabled {false};
+    bool ReceiveRetainEnabled {false};
+    bool HeadersCompleteEnabled {false};
+    bool ContentLengthEnabled {false};
+    uint32_t MaxFieldSectionSize {MSH3_DEFAULT_MAX_FIELD_SECTION_SIZE};
+    uint16_t SendHighWatermarkPercent {0};  // Zero if backpressure is disabled
+    uint16_t SendLowWatermarkPercent {0};
     QUIC_CREDENTIAL_CONFIG* SelfSign {nullptr};
     MsH3pConfiguration(
         const MsQuicRegistration& Registration,
@@ -310,7 +883,9 @@ struct MsH3pConnection : public MsQuicConnection {
     MSH3_CONNECTION_CALLBACK_HANDLER Callbacks {nullptr};
     void* Context {nullptr};
 
+    std::mutex EncoderLock; // Serializes Encoder use between app threads and the worker
     struct lsqpack_enc Encoder;
+    std::recursive_mutex DecoderLock; // Same for Decoder; never held while calling the app
     struct lsqpack_dec Decoder;
     uint8_t tsu_buf[LSQPACK_LONGEST_SDTC];
     size_t tsu_buf_sz;
@@ -333,6 +908,21 @@ struct MsH3pConnection : public MsQuicConnection {
 
     bool DynamicQPackEnabled {false};
 
+    MsH3pPool AppSendPool {sizeof(MsH3pAppSend), MSH3_APP_SEND_POOL_MAX_DEPTH};
+    MsH3pPool SendBufferPool {MSH3_SEND_BUFFER_SIZE, MSH3_SEND_BUFFER_POOL_MAX_DEPTH};
+    uint32_t SendBufferingThreshold {0};
+    bool SendCompleteBatchEnabled {false};
+    bool ReceiveVectoredEnabled {false};
+    bool ReceiveRetainEnabled {false};
+    bool HeadersCompleteEnabled {false};
+    bool ContentLengthEnabled {false};
+    uint32_t MaxFieldSectionSize {MSH3_DEFAULT_MAX_FIELD_SECTION_SIZE};
+    uint16_t SendHighWatermarkPercent {0};  // Zero if backpressure is disabled
+    uint16_t SendLowWatermarkPercent {0};
+
+    MsH3pPool EncodeBufferPool {MSH3_ENCODE_BUFFER_POOL_SIZE, MSH3_ENCODE_BUFFER_POOL_MAX_DEPTH};
+    MsH3pPool DecodeBufferPool {MSH3_DECODE_BUFFER_POOL_SIZE, MSH3_DECODE_BUFFER_POOL_MAX_DEPTH};
+
     char HostName[256];
 
     MsH3pConnection(
@@ -369,6 +959,13 @@ struct MsH3pConnection : public MsQuicConnection {
         const MSH3_ADDR* ServerAddress
         );
 
+    uint32_t
+    SubmitRequests(
+        _Inout_updates_(SubmissionCount)
+            MSH3_REQUEST_SUBMISSION* Submissions,
+        _In_ uint32_t SubmissionCount
+        );
+
     void WaitOnShutdownComplete() {
         std::unique_lock Lock{ShutdownCompleteMutex};
         ShutdownCompleteEvent.wait(Lock, [&]{return ShutdownComplete;});
@@ -418,6 +1015,9 @@ struct MsH3pUniDirStream : public MsQuicStream {
     uint8_t RawBuffer[256];
     QUIC_BUFFER Buffer {0, RawBuffer}; // Working space
 
+    MsH3pVarIntReader StreamTypeReader;     // Peer streams only
+    MsH3pFrameReader FrameReader {MSH3_CONTROL_FRAME_MAX_PAYLOAD, MsH3pIsControlFrameType}; // Control stream only
+
     MsH3pUniDirStream(MsH3pConnection& Connection, H3StreamType Type);
     MsH3pUniDirStream(MsH3pConnection& Connection, const MsH3pConfiguration& Configuration); // Type == H3StreamTypeControl
     MsH3pUniDirStream(MsH3pConnection& Connection, const HQUIC StreamHandle);
@@ -432,6 +1032,22 @@ struct MsH3pUniDirStream : public MsQuicStream {
         _In_ size_t HeadersCount
         );
 
+    // Requires EncoderLock. Appends any encoder instructions to EncoderOutput.
+    bool
+    EncodeHeaderBlock(
+        _In_ struct MsH3pBiDirStream* Request,
+        _In_reads_(HeadersCount)
+            const MSH3_HEADER* Headers,
+        _In_ size_t HeadersCount,
+        _Inout_ MsH3pEncodeBuffer* EncoderOutput
+        );
+
+    // Requires EncoderLock. Takes ownership of EncoderOutput.
+    void
+    SendEncoderOutput(
+        _In_ MsH3pEncodeBuffer* EncoderOutput
+        );
+
     // Decoder functions
 
     void
@@ -495,23 +1111,9 @@ private:
         );
 };
 
-struct MsH3pAppSend {
-    void* AppContext;
-    uint8_t FrameHeaderBuffer[16];
-    QUIC_BUFFER Buffers[2] = {
-        0, FrameHeaderBuffer,
-        0, NULL
-    };
-    MsH3pAppSend(_In_opt_ void* AppContext) : AppContext(AppContext) { }
-    bool SetData(
-        _In_reads_bytes_opt_(DataLength) const void* Data,
-        _In_ uint32_t DataLength
-        )
-    {
-        Buffers[1].Length = DataLength;
-        Buffers[1].Buffer = (uint8_t*)Data;
-        return H3WriteFrameHeader(H3FrameData, DataLength, &Buffers[0].Length, sizeof(FrameHeaderBuffer), FrameHeaderBuffer);
-    }
+struct MsH3pRetainedRecv {
+    uint64_t Offset;    // Stream offset of the first retained byte
+    bool Released;
 };
 
 struct MsH3pBiDirStream : public MsQuicStream {
@@ -523,7 +1125,8 @@ struct MsH3pBiDirStream : public MsQuicStream {
 
     uint8_t FrameHeaderBuffer[16];
     uint8_t PrefixBuffer[32];
-    uint8_t HeadersBuffer[256];
+    uint8_t HeadersBuffer[256];             // Inline space for the common, small header block
+    MsH3pEncodeBuffer* HeadersBlock {nullptr}; // Used instead when HeadersBuffer is too small
     QUIC_BUFFER Buffers[3] = { // TODO - Put in AppSend struct?
         {0, FrameHeaderBuffer},
         {0, PrefixBuffer},
@@ -532,7 +1135,26 @@ struct MsH3pBiDirStream : public MsQuicStream {
 
     static struct lsqpack_dec_hset_if hset_if;
     struct lsxpack_header CurDecodeHeader;
-    char DecodeBuffer[4096];
+    char* DecodeBuffer {nullptr};       // Only held while a header block is being decoded
+    uint32_t DecodeBufferSize {0};      // MSH3_DECODE_BUFFER_POOL_SIZE if from the pool
+    uint32_t DecodeLength {0};          // Of the section's headers (and records) in DecodeBuffer
+    uint32_t DecodeSectionSize {0};     // Of the section being decoded, per RFC 9114 4.2.2
+    MsH3pHeaderArena HeaderArena;       // Sections for HEADERS_COMPLETE, kept until close
+    bool SectionTooLarge {false};       // Over MaxFieldSectionSize, or out of HeaderArena space
+    std::vector<MSH3_HEADER> SectionHeaders; // Decoded so far in the current section
+    MSH3_PSEUDO_HEADERS PseudoHeaders {};   // Of the latest section that had any, under ReceiveLock
+    bool HasPseudoHeaders {false};          // Under ReceiveLock
+    MSH3_PSEUDO_HEADERS SectionPseudoHeaders {}; // Of the current section, published once complete
+    bool SectionHasPseudoHeaders {false};
+    uint64_t SectionContentLength {UINT64_MAX}; // In the current section, if any
+    bool SectionContentLengthInvalid {false};
+    uint64_t ContentLength {UINT64_MAX};    // Of the body being received, if known
+    uint64_t ReceivedBodyLength {0};        // Of all the DATA frames started so far
+    bool SentHeadRequest {false};           // So the response has no body, whatever its content-length
+    bool ReceiveAborted {false};            // Locally, e.g. with H3_MESSAGE_ERROR
+    bool ReceiveToFile {false};             // Body data is written to ReceiveFile
+    MSH3_FILE ReceiveFile;
+    uint64_t ReceiveFileOffset {0};         // Where the next body data is written
 
     QUIC_VAR_INT CurFrameType {0};
     QUIC_VAR_INT CurFrameLength {0};
@@ -543,9 +1165,57 @@ struct MsH3pBiDirStream : public MsQuicStream {
     uint8_t BufferedHeaders[2*sizeof(uint64_t)];
     uint32_t BufferedHeadersLength {0};
 
+    H3FrameRef ScannedFrames[MSH3_SCAN_FRAMES_MAX]; // Ahead of CurRecvOffset in the current buffer
+    uint32_t ScannedFrameCount {0};
+    uint32_t ScannedFrameIndex {0};
+
+    // The receive event being parsed, kept across an app's pending receive
+    const QUIC_BUFFER* RecvBuffers {nullptr};
+    uint32_t RecvBufferCount {0};
+    uint32_t RecvBufferIndex {0};
+    QUIC_BUFFER ParkedRecvBuffers[MSH3_PARKED_RECV_BUFFERS]; // Copy of the event's (stack) array
+
+    std::mutex ReceiveLock;             // Between the parser and CompleteReceive
+    uint32_t ReceivePendingLength {0};  // Length of the DATA indicated as pending
+    uint32_t ReceiveCompletedLength {0};// Completed during the DATA_RECEIVED callback
+    bool ReceiveParked {false};         // Parser stopped until CompleteReceive
+    bool ReceivePendingSlices {false};  // The pending indication was DATA_RECEIVED_V
+
+    MSH3_BUFFER RecvSlices[MSH3_RECV_SLICES_MAX]; // Collected for DATA_RECEIVED_V
+    uint32_t RecvSliceCount {0};
+    uint64_t RecvSliceLength {0};
+    uint64_t RecvSliceOffset {0};       // Stream offset of RecvSlices[0]
+
+    // Retained data (ReceiveRetainEnabled), completed back to MsQuic in order
+    std::deque<MsH3pRetainedRecv> RetainedRecvs; // Protected by ReceiveLock
+    uint64_t RetainedRecvHeadId {1};    // Id of RetainedRecvs.front()
+    uint64_t RecvEventOffset {0};       // Stream offset of the current receive event
+    uint64_t RecvCompletedOffset {0};   // Completed back to MsQuic so far
+    uint64_t RetainOffset {0};          // Stream offset of the data being indicated
+    std::atomic<std::thread::id> RetainThread; // Thread in a DATA_RECEIVED(_V) callback, if any
+
+    uint64_t DeclaredDataLeft {0};      // Body bytes left to send under the declared DATA frame
+    bool DeclaredFrameHeaderSent {false};
+
+    std::atomic_uint32_t AppSendsInFlight {0};
+    uint32_t SendCompleteBatchCount {0};
+    void* SendCompleteBatch[MSH3_SEND_COMPLETE_BATCH_SIZE];
+
+    std::recursive_mutex CoalesceLock;  // A flush's send may complete inline
+    MsH3pSharedBuffer* CoalesceBuffer {nullptr};    // Data pending from coalesced writes
+    uint32_t CoalesceLength {0};
+    uint32_t CoalesceFlushesInFlight {0};
+
+    std::mutex FileSendLock;
+    MsH3pFileSend* FileSend {nullptr};  // File body currently being sent
+    std::atomic_bool FileSendActive {false}; // Checked by app sends without the lock
+    std::atomic_uint64_t IdealSendSize {MSH3_FILE_SEND_DEFAULT_IN_FLIGHT};
+    std::atomic_uint64_t BytesInFlight {0};     // Sent but not yet completed
+    std::atomic_bool WritableNeeded {false};    // A send was rejected by the high watermark
+
     bool Complete {false};
     bool ShutdownComplete {false};
-    bool ReceivePending {false};
+    bool ReceivePending {false};        // App returned (or may return) MSH3_STATUS_PENDING
 
     MsH3pBiDirStream(
         _In_ MsH3pConnection& Connection,
@@ -563,19 +1233,106 @@ struct MsH3pBiDirStream : public MsQuicStream {
         ) : MsQuicStream(StreamHandle, CleanUpManual, s_MsQuicCallback, this),
             H3(Connection) { }
 
+    ~MsH3pBiDirStream() {
+        if (CoalesceBuffer) CoalesceBuffer->Release();
+        delete FileSend; // All its chunks completed before the stream shut down
+        MsH3pEncodeBuffer::Free(HeadersBlock);
+        ReleaseDecodeBuffer();
+    }
+
+    uint8_t*
+    ReserveHeadersBuffer(
+        _In_ size_t Length
+        )
+    {
+        MsH3pEncodeBuffer::Free(HeadersBlock);
+        HeadersBlock = nullptr;
+        if (Length <= sizeof(HeadersBuffer)) {
+            Buffers[2].Buffer = HeadersBuffer;
+        } else {
+            HeadersBlock = MsH3pEncodeBuffer::Alloc(H3.EncodeBufferPool, Length);
+            if (!HeadersBlock) return nullptr;
+            Buffers[2].Buffer = HeadersBlock->Data();
+        }
+        return Buffers[2].Buffer;
+    }
+
     void
     CompleteReceive(
         _In_ uint32_t Length
         );
 
+    uint64_t
+    RetainReceive();
+
+    bool
+    SetReceiveFile(
+        _In_ MSH3_FILE File,
+        _In_ uint64_t Offset
+        );
+
+    void
+    WriteReceivedSlices();
+
+    void
+    ReleaseReceive(
+        _In_ uint64_t RetainId
+        );
+
     bool
     Send(
         _In_ MSH3_REQUEST_SEND_FLAGS Flags,
         _In_reads_(HeadersCount)
             const MSH3_HEADER* Headers,
         _In_ size_t HeadersCount,
-        _In_reads_bytes_(DataLength) const void* Data,
-        _In_ uint32_t DataLength,
+        _In_reads_(DataBufferCount)
+            const MSH3_BUFFER* DataBuffers,
+        _In_ uint32_t DataBufferCount,
+        _In_opt_ void* AppContext,
+        _In_opt_ MsH3pSharedBuffer* SharedBuffer,
+        _In_ MsH3pSendKind Kind
+        );
+
+    // Sends the header block already encoded in Buffers, and optional data.
+    bool
+    SendEncoded(
+        _In_ MSH3_REQUEST_SEND_FLAGS Flags,
+        _In_reads_(DataBufferCount)
+            const MSH3_BUFFER* DataBuffers,
+        _In_ uint32_t DataBufferCount,
+        _In_opt_ void* AppContext
+        );
+
+    bool
+    SendTemplate(
+        _In_ MSH3_REQUEST_SEND_FLAGS Flags,
+        _In_ MsH3pHeaderTemplate* Template,
+        _In_reads_(SlotValueCount)
+            const MSH3_BUFFER* SlotValues,
+        _In_ uint32_t SlotValueCount,
+        _In_reads_(DataBufferCount)
+            const MSH3_BUFFER* DataBuffers,
+        _In_ uint32_t DataBufferCount,
+        _In_opt_ void* AppContext
+        );
+
+    bool
+    SetSendBodyLength(
+        _In_ uint64_t Length
+        );
+
+    bool
+    Flush();
+
+    bool
+    SendFile(
+        _In_ MSH3_REQUEST_SEND_FLAGS Flags,
+        _In_reads_(HeadersCount)
+            const MSH3_HEADER* Headers,
+        _In_ size_t HeadersCount,
+        _In_ MSH3_FILE File,
+        _In_ uint64_t Offset,
+        _In_ uint64_t Length,
         _In_opt_ void* AppContext
         );
 
@@ -591,11 +1348,101 @@ struct MsH3pBiDirStream : public MsQuicStream {
 
 private:
 
+    bool
+    ValidateSend(
+        _In_ MSH3_REQUEST_SEND_FLAGS Flags,
+        _In_ bool HasHeaders,
+        _In_reads_(DataBufferCount)
+            const MSH3_BUFFER* DataBuffers,
+        _In_ uint32_t DataBufferCount,
+        _Out_ uint64_t* DataLength
+        );
+
+    void
+    IndicateSendCompleteBatch();
+
+    bool
+    IsWritable();
+
+    void
+    IndicateWritable();
+
+    bool
+    Coalesce(
+        _In_ MSH3_REQUEST_SEND_FLAGS Flags,
+        _In_reads_(DataBufferCount)
+            const MSH3_BUFFER* DataBuffers,
+        _In_ uint32_t DataBufferCount,
+        _In_opt_ void* AppContext
+        );
+
+    bool
+    FlushLocked();
+
+    void
+    CompleteCoalesced(
+        _In_ MsH3pSharedBuffer* Buffer
+        );
+
+    void
+    PumpFileSend(
+        _Inout_ std::unique_lock<std::mutex>& Lock,
+        _In_reads_(HeadersCount)
+            const MSH3_HEADER* Headers,
+        _In_ size_t HeadersCount
+        );
+
+    void
+    CompleteFileSendIfIdle(
+        _Inout_ std::unique_lock<std::mutex>& Lock
+        );
+
+    void
+    CompleteFileSend(
+        _In_ MsH3pSharedBuffer* Chunk,
+        _In_ bool Canceled
+        );
+
+    bool
+    SendFrames(
+        _In_ MSH3_REQUEST_SEND_FLAGS Flags,
+        _In_ bool HasHeaders,
+        _In_opt_ MsH3pHeaderTemplate* Template,
+        _In_reads_(DataBufferCount)
+            const MSH3_BUFFER* DataBuffers,
+        _In_ uint32_t DataBufferCount,
+        _In_ uint64_t DataLength,
+        _In_opt_ void* AppContext,
+        _In_opt_ MsH3pSharedBuffer* SharedBuffer,
+        _In_ MsH3pSendKind Kind
+        );
+
     QUIC_STATUS
     Receive(
         _Inout_ QUIC_STREAM_EVENT* Event
         );
 
+    bool
+    ProcessReceive(
+        _Out_ uint64_t* CompleteLength
+        );
+
+    bool
+    IndicateReceivedSlices();
+
+    void
+    ParkReceive();
+
+    uint64_t
+    AdvanceRetainedCompletion();
+
+    bool
+    ConsumeReceivedData(
+        _In_ uint32_t Consumed,
+        _In_ uint32_t Indicated,
+        _Out_ uint64_t* CompleteLength
+        );
+
     static QUIC_STATUS
     s_MsQuicCallback(
         _In_ MsQuicStream* /* Stream */,
@@ -635,20 +1482,64 @@ private:
         size_t Space
         );
 
+    bool
+    GrowDecodeBuffer(
+        _In_ size_t Space,
+        _In_ size_t PreserveLength
+        );
+
+    void
+    ReleaseDecodeBuffer();
+
     static int
     s_DecodeProcess(
         void *Context,
         struct lsxpack_header* Header
         )
     {
-        ((MsH3pBiDirStream*)Context)->DecodeProcess(Header);
-        return 0;
+        return ((MsH3pBiDirStream*)Context)->DecodeProcess(Header) ? 0 : -1;
     }
 
-    void
+    bool
     DecodeProcess(
         struct lsxpack_header* Header
         );
+
+    void
+    RecordPseudoHeader(
+        _In_ H3PseudoHeader Field,
+        _In_ const MSH3_HEADER& Header
+        );
+
+    void
+    PublishPseudoHeaders(
+        _In_ bool Clear = false
+        );
+
+    void
+    RecordContentLength(
+        _In_ const MSH3_HEADER& Header
+        );
+
+    void
+    CompleteContentLength();
+
+    bool
+    DiscardReceive(
+        _Out_ uint64_t* CompleteLength
+        );
+
+    void
+    AbortReceive(
+        _In_ H3ErrorCode ErrorCode,
+        _In_ bool AbortSend
+        );
+
+    void
+    IndicateHeadersComplete();
+
+    void
+    IndicateDecodedHeaders();
 };
 
 struct MsH3pListener : public MsQuicListener {
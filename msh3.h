@@ -25,6 +25,7 @@
 #define MSH3_STATUS_INVALID_STATE   E_NOT_VALID_STATE
 #define MSH3_FAILED(X) FAILED(X)
 typedef HANDLE MSH3_EVENTQ;
+typedef HANDLE MSH3_FILE;
 typedef OVERLAPPED_ENTRY MSH3_CQE;
 typedef
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -50,6 +51,7 @@ typedef struct MSH3_SQE {
 #define MSH3_STATUS_PENDING         ((MSH3_STATUS)-2)
 #define MSH3_STATUS_INVALID_STATE   ((MSH3_STATUS)EPERM)
 #define MSH3_FAILED(X) ((int)(X) > 0)
+typedef int MSH3_FILE;
 #if __linux__ // epoll
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
@@ -121,6 +123,10 @@ typedef struct MSH3_CONFIGURATION MSH3_CONFIGURATION;
 typedef struct MSH3_CONNECTION MSH3_CONNECTION;
 typedef struct MSH3_REQUEST MSH3_REQUEST;
 typedef struct MSH3_LISTENER MSH3_LISTENER;
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+typedef struct MSH3_HEADER_TEMPLATE MSH3_HEADER_TEMPLATE;
+typedef struct MSH3_SHARED_BUFFER MSH3_SHARED_BUFFER;
+#endif
 
 typedef enum MSH3_CREDENTIAL_TYPE {
     MSH3_CREDENTIAL_TYPE_NONE,
@@ -163,6 +169,9 @@ typedef enum MSH3_REQUEST_SEND_FLAGS {
     MSH3_REQUEST_SEND_FLAG_ALLOW_0_RTT                  = 0x0001,   // Allows the use of encrypting with 0-RTT key.
     MSH3_REQUEST_SEND_FLAG_FIN                          = 0x0002,   // Indicates the request should be gracefully shutdown too.
     MSH3_REQUEST_SEND_FLAG_DELAY_SEND                   = 0x0004,   // Indicates the send should be delayed because more will be queued soon.
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+    MSH3_REQUEST_SEND_FLAG_COALESCE                     = 0x0008,   // Small data is copied and aggregated with neighboring writes into one DATA frame.
+#endif
 } MSH3_REQUEST_SEND_FLAGS;
 
 DEFINE_ENUM_FLAG_OPERATORS(MSH3_REQUEST_SEND_FLAGS)
@@ -197,6 +206,14 @@ typedef struct MSH3_SETTINGS {
 #ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
             uint64_t XdpEnabled                             : 1;
             uint64_t DynamicQPackEnabled                    : 1;
+            uint64_t SendBufferingThreshold                 : 1;
+            uint64_t SendCompleteBatchEnabled               : 1;
+            uint64_t SendWatermarks                         : 1;
+            uint64_t ReceiveVectoredEnabled                 : 1;
+            uint64_t ReceiveRetainEnabled                   : 1;
+            uint64_t HeadersCompleteEnabled                 : 1;
+            uint64_t MaxFieldSectionSize                    : 1;
+            uint64_t ContentLengthEnabled                   : 1;
 #endif
         } IsSet;
     };
@@ -209,10 +226,20 @@ typedef struct MSH3_SETTINGS {
 #ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
     uint8_t XdpEnabled : 1;
     uint8_t DynamicQPackEnabled : 1;
-    uint8_t RESERVED : 5;
+    uint8_t SendCompleteBatchEnabled : 1;
+    uint8_t ReceiveVectoredEnabled : 1;
+    uint8_t ReceiveRetainEnabled : 1;
+    uint8_t HeadersCompleteEnabled : 1;
+    uint8_t ContentLengthEnabled : 1;
 #else
     uint8_t RESERVED : 7;
 #endif
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+    uint32_t SendBufferingThreshold; // Data sends up to this size are copied by the library
+    uint16_t SendHighWatermarkPercent; // Of the ideal send size, sends are rejected above this
+    uint16_t SendLowWatermarkPercent;  // Of the ideal send size, WRITABLE is indicated below this
+    uint32_t MaxFieldSectionSize; // Largest received header section accepted and advertised to the peer
+#endif
 } MSH3_SETTINGS;
 
 typedef struct MSH3_CERTIFICATE_HASH {
@@ -276,6 +303,44 @@ typedef struct MSH3_HEADER {
     size_t ValueLength;
 } MSH3_HEADER;
 
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+typedef struct MSH3_BUFFER {
+    uint32_t Length;
+    const uint8_t* Buffer;
+} MSH3_BUFFER;
+
+typedef enum MSH3_METHOD {
+    MSH3_METHOD_NONE        = 0,    // No :method (e.g. a response)
+    MSH3_METHOD_OTHER       = 1,    // Not one of the below; see HEADER_RECEIVED
+    MSH3_METHOD_GET         = 2,
+    MSH3_METHOD_HEAD        = 3,
+    MSH3_METHOD_POST        = 4,
+    MSH3_METHOD_PUT         = 5,
+    MSH3_METHOD_DELETE      = 6,
+    MSH3_METHOD_CONNECT     = 7,
+    MSH3_METHOD_OPTIONS     = 8,
+    MSH3_METHOD_TRACE       = 9,
+    MSH3_METHOD_PATCH       = 10,
+} MSH3_METHOD;
+
+//
+// The pseudo-header fields of a received header section, already parsed.
+// Strings are not null terminated. With HeadersCompleteEnabled, they stay valid
+// until the request is closed; otherwise, only during the section's
+// HEADER_RECEIVED events. Absent fields are zero/NULL.
+//
+typedef struct MSH3_PSEUDO_HEADERS {
+    MSH3_METHOD Method;
+    uint32_t Status;                // :status, or 0 if absent or not 3 digits
+    const char* Path;
+    uint32_t PathLength;
+    const char* Authority;
+    uint32_t AuthorityLength;
+    const char* Scheme;
+    uint32_t SchemeLength;
+} MSH3_PSEUDO_HEADERS;
+#endif
+
 //
 // API global interface
 //
@@ -438,6 +503,36 @@ MsH3ConnectionGetQuicParam(
     void* Buffer
     );
 
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+typedef enum MSH3_CONNECTION_PARAM {
+    MSH3_PARAM_CONNECTION_POOL_STATISTICS   = 0,    // MSH3_CONNECTION_POOL_STATISTICS
+} MSH3_CONNECTION_PARAM;
+
+typedef struct MSH3_POOL_STATISTICS {
+    uint64_t AllocCount;        // Total allocations
+    uint64_t HeapAllocCount;    // Allocations the free list couldn't satisfy
+    uint64_t HeapFreeCount;     // Frees that went back to the heap (free list full)
+    uint32_t InUseCount;        // Currently outstanding
+    uint32_t CachedCount;       // Currently on the free list
+} MSH3_POOL_STATISTICS;
+
+typedef struct MSH3_CONNECTION_POOL_STATISTICS {
+    MSH3_POOL_STATISTICS AppSend;       // Per DATA send contexts
+    MSH3_POOL_STATISTICS SendBuffer;    // Copies of small sends (SendBufferingThreshold)
+    MSH3_POOL_STATISTICS EncodeBuffer;  // Header block encode buffers
+    MSH3_POOL_STATISTICS DecodeBuffer;  // Header block decode buffers
+} MSH3_CONNECTION_POOL_STATISTICS;
+
+MSH3_STATUS
+MSH3_CALL
+MsH3ConnectionGetParam(
+    MSH3_CONNECTION* Connection,
+    MSH3_CONNECTION_PARAM Param,
+    uint32_t* BufferLength,
+    void* Buffer
+    );
+#endif
+
 //
 // Request Interface
 //
@@ -452,6 +547,13 @@ typedef enum MSH3_REQUEST_EVENT_TYPE {
     MSH3_REQUEST_EVENT_SEND_COMPLETE                     = 6,
     MSH3_REQUEST_EVENT_SEND_SHUTDOWN_COMPLETE            = 7,
     MSH3_REQUEST_EVENT_PEER_RECEIVE_ABORTED              = 8,
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+    MSH3_REQUEST_EVENT_SEND_COMPLETE_BATCH               = 9,    // Only if SendCompleteBatchEnabled is set.
+    MSH3_REQUEST_EVENT_WRITABLE                          = 10,   // Only if SendWatermarks are set.
+    MSH3_REQUEST_EVENT_DATA_RECEIVED_V                   = 11,   // Only if ReceiveVectoredEnabled is set.
+    MSH3_REQUEST_EVENT_HEADERS_COMPLETE                  = 12,   // Only if HeadersCompleteEnabled is set.
+    MSH3_REQUEST_EVENT_BODY_SIZE_HINT                    = 13,   // Only if ContentLengthEnabled is set.
+#endif
     // Future events may be added. Existing code should
     // return NOT_SUPPORTED for any unknown event.
 } MSH3_REQUEST_EVENT_TYPE;
@@ -495,6 +597,25 @@ typedef struct MSH3_REQUEST_EVENT {
         struct {
             uint64_t ErrorCode;
         } PEER_RECEIVE_ABORTED;
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+        struct {
+            uint32_t Count;
+            void* const* ClientContexts;
+        } SEND_COMPLETE_BATCH;
+        struct {
+            uint32_t BufferCount;
+            const MSH3_BUFFER* Buffers;
+            uint64_t TotalLength;
+        } DATA_RECEIVED_V;
+        struct {
+            uint32_t HeaderCount;
+            const MSH3_HEADER* Headers;
+            const MSH3_PSEUDO_HEADERS* PseudoHeaders; // NULL if the section had none (trailers)
+        } HEADERS_COMPLETE;
+        struct {
+            uint64_t ContentLength; // Total body length that will be received
+        } BODY_SIZE_HINT;
+#endif
     };
 } MSH3_REQUEST_EVENT;
 
@@ -537,6 +658,129 @@ MsH3RequestSend(
     void* AppContext
     );
 
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+bool
+MSH3_CALL
+MsH3RequestSendV(
+    MSH3_REQUEST* Request,
+    MSH3_REQUEST_SEND_FLAGS Flags,
+    const MSH3_HEADER* Headers,
+    size_t HeadersCount,
+    const MSH3_BUFFER* Buffers,
+    uint32_t BufferCount,
+    void* AppContext
+    );
+
+bool
+MSH3_CALL
+MsH3RequestSetSendBodyLength(
+    MSH3_REQUEST* Request,
+    uint64_t Length // Total body length, sent as a single DATA frame
+    );
+
+bool
+MSH3_CALL
+MsH3RequestFlush(
+    MSH3_REQUEST* Request // Sends any data pending from coalesced writes
+    );
+
+bool
+MSH3_CALL
+MsH3RequestSendFile(
+    MSH3_REQUEST* Request,
+    MSH3_REQUEST_SEND_FLAGS Flags,
+    const MSH3_HEADER* Headers,
+    size_t HeadersCount,
+    MSH3_FILE File, // Must stay open until the send completes
+    uint64_t Offset,
+    uint64_t Length,
+    void* AppContext
+    );
+
+//
+// Header Templates
+//
+
+MSH3_HEADER_TEMPLATE*
+MSH3_CALL
+MsH3HeaderTemplateOpen(
+    const MSH3_HEADER* Headers, // Headers with a NULL Value are slots
+    size_t HeadersCount
+    );
+
+void
+MSH3_CALL
+MsH3HeaderTemplateClose(
+    MSH3_HEADER_TEMPLATE* Template
+    );
+
+bool
+MSH3_CALL
+MsH3RequestSendTemplate(
+    MSH3_REQUEST* Request,
+    MSH3_REQUEST_SEND_FLAGS Flags,
+    MSH3_HEADER_TEMPLATE* Template,
+    const MSH3_BUFFER* SlotValues, // One per slot, in template order; copied
+    uint32_t SlotValueCount,
+    const void* Data,
+    uint32_t DataLength,
+    void* AppContext
+    );
+
+//
+// Shared Buffers
+//
+
+MSH3_SHARED_BUFFER*
+MSH3_CALL
+MsH3SharedBufferOpen(
+    const void* Data, // Copied into the shared buffer
+    uint32_t Length
+    );
+
+void
+MSH3_CALL
+MsH3SharedBufferClose(
+    MSH3_SHARED_BUFFER* SharedBuffer
+    );
+
+bool
+MSH3_CALL
+MsH3RequestSendShared(
+    MSH3_REQUEST* Request,
+    MSH3_REQUEST_SEND_FLAGS Flags,
+    const MSH3_HEADER* Headers,
+    size_t HeadersCount,
+    MSH3_SHARED_BUFFER* SharedBuffer,
+    void* AppContext
+    );
+
+//
+// Batch Submission
+//
+
+typedef struct MSH3_REQUEST_SUBMISSION {
+    MSH3_REQUEST_CALLBACK_HANDLER Handler;
+    void* Context;
+    MSH3_REQUEST_FLAGS Flags;
+    MSH3_REQUEST_SEND_FLAGS SendFlags;
+    const MSH3_HEADER* Headers;
+    size_t HeadersCount;
+    const void* Data;
+    uint32_t DataLength;
+    void* AppContext;
+    MSH3_REQUEST* Request; // Set on return; NULL if the request failed
+} MSH3_REQUEST_SUBMISSION;
+
+uint32_t
+MSH3_CALL
+MsH3RequestSubmitBatch(
+    MSH3_CONNECTION* Connection,
+    MSH3_REQUEST_SUBMISSION* Submissions,
+    uint32_t SubmissionCount
+    ); // Returns the number of requests successfully opened and sent
+#endif
+
 void
 MSH3_CALL
 MsH3RequestSetReceiveEnabled(
@@ -551,6 +795,45 @@ MsH3RequestCompleteReceive(
     uint32_t Length
     );
 
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+uint64_t
+MSH3_CALL
+MsH3RequestRetainReceive(
+    MSH3_REQUEST* Request
+    ); // Only in a DATA_RECEIVED(_V) callback with ReceiveRetainEnabled. Returns 0 on failure.
+
+void
+MSH3_CALL
+MsH3RequestReleaseReceive(
+    MSH3_REQUEST* Request,
+    uint64_t RetainId
+    );
+
+//
+// Gets the pseudo-headers of the latest received header section that had any
+// (the request or final response head). Returns false if none were received.
+//
+bool
+MSH3_CALL
+MsH3RequestGetPseudoHeaders(
+    MSH3_REQUEST* Request,
+    MSH3_PSEUDO_HEADERS* PseudoHeaders
+    );
+
+//
+// Writes the received body to File, starting at Offset, instead of indicating
+// it with DATA_RECEIVED(_V) events. Call from the request callback before any
+// body data is received, e.g. on HEADER_RECEIVED.
+//
+bool
+MSH3_CALL
+MsH3RequestSetReceiveFile(
+    MSH3_REQUEST* Request,
+    MSH3_FILE File, // Must stay open until the request is closed
+    uint64_t Offset
+    );
+#endif
+
 void
 MSH3_CALL
 MsH3RequestShutdown(
@@ -215,6 +215,34 @@ struct MsH3Configuration {
     }
 };
 
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+struct MsH3HeaderTemplate {
+    MSH3_HEADER_TEMPLATE* Handle { nullptr };
+    MsH3HeaderTemplate(const MSH3_HEADER* Headers, size_t HeadersCount) noexcept {
+        Handle = MsH3HeaderTemplateOpen(Headers, HeadersCount);
+    }
+    ~MsH3HeaderTemplate() noexcept { if (Handle) { MsH3HeaderTemplateClose(Handle); } }
+    MsH3HeaderTemplate(MsH3HeaderTemplate& other) = delete;
+    MsH3HeaderTemplate operator=(MsH3HeaderTemplate& Other) = delete;
+    bool IsValid() const noexcept { return Handle != nullptr; }
+    operator MSH3_HEADER_TEMPLATE* () const noexcept { return Handle; }
+};
+#endif
+
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+struct MsH3SharedBuffer {
+    MSH3_SHARED_BUFFER* Handle { nullptr };
+    MsH3SharedBuffer(const void* Data, uint32_t Length) noexcept {
+        Handle = MsH3SharedBufferOpen(Data, Length);
+    }
+    ~MsH3SharedBuffer() noexcept { if (Handle) { MsH3SharedBufferClose(Handle); } }
+    MsH3SharedBuffer(MsH3SharedBuffer& other) = delete;
+    MsH3SharedBuffer operator=(MsH3SharedBuffer& Other) = delete;
+    bool IsValid() const noexcept { return Handle != nullptr; }
+    operator MSH3_SHARED_BUFFER* () const noexcept { return Handle; }
+};
+#endif
+
 struct MsH3Addr {
     MSH3_ADDR Addr {0};
     MsH3Addr(uint16_t Port TEST_DEF(4433)) {
@@ -322,6 +350,14 @@ struct MsH3Connection {
     void Shutdown(uint64_t ErrorCode = 0) noexcept {
         MsH3ConnectionShutdown(Handle, ErrorCode);
     }
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+    uint32_t SubmitBatch(MSH3_REQUEST_SUBMISSION* Submissions, uint32_t SubmissionCount) noexcept {
+        return MsH3RequestSubmitBatch(Handle, Submissions, SubmissionCount);
+    }
+    MSH3_STATUS GetParam(MSH3_CONNECTION_PARAM Param, uint32_t* BufferLength, void* Buffer) noexcept {
+        return MsH3ConnectionGetParam(Handle, Param, BufferLength, Buffer);
+    }
+#endif
     static
     MSH3_STATUS
     NoOpCallback(
@@ -484,6 +520,20 @@ struct MsH3Request {
     void CompleteReceive(uint32_t Length) noexcept {
         MsH3RequestCompleteReceive(Handle, Length);
     };
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+    uint64_t RetainReceive() noexcept {
+        return MsH3RequestRetainReceive(Handle);
+    };
+    void ReleaseReceive(uint64_t RetainId) noexcept {
+        MsH3RequestReleaseReceive(Handle, RetainId);
+    };
+    bool GetPseudoHeaders(MSH3_PSEUDO_HEADERS* PseudoHeaders) noexcept {
+        return MsH3RequestGetPseudoHeaders(Handle, PseudoHeaders);
+    };
+    bool SetReceiveFile(MSH3_FILE File, uint64_t Offset = 0) noexcept {
+        return MsH3RequestSetReceiveFile(Handle, File, Offset);
+    };
+#endif
     void SetReceiveEnabled(bool Enabled) noexcept {
         MsH3RequestSetReceiveEnabled(Handle, Enabled);
     };
@@ -497,6 +547,55 @@ struct MsH3Request {
         ) noexcept {
         return MsH3RequestSend(Handle, Flags, Headers, HeadersCount, Data, DataLength, SendContext);
     }
+#ifdef MSH3_API_ENABLE_PREVIEW_FEATURES
+    bool SendV(
+        const MSH3_HEADER* Headers,
+        size_t HeadersCount,
+        const MSH3_BUFFER* Buffers,
+        uint32_t BufferCount,
+        MSH3_REQUEST_SEND_FLAGS Flags = MSH3_REQUEST_SEND_FLAG_NONE,
+        void* SendContext = nullptr
+        ) noexcept {
+        return MsH3RequestSendV(Handle, Flags, Headers, HeadersCount, Buffers, BufferCount, SendContext);
+    }
+    bool SetSendBodyLength(uint64_t Length) noexcept {
+        return MsH3RequestSetSendBodyLength(Handle, Length);
+    }
+    bool Flush() noexcept {
+        return MsH3RequestFlush(Handle);
+    }
+    bool SendFile(
+        const MSH3_HEADER* Headers,
+        size_t HeadersCount,
+        MSH3_FILE File,
+        uint64_t Offset,
+        uint64_t Length,
+        MSH3_REQUEST_SEND_FLAGS Flags = MSH3_REQUEST_SEND_FLAG_NONE,
+        void* SendContext = nullptr
+        ) noexcept {
+        return MsH3RequestSendFile(Handle, Flags, Headers, HeadersCount, File, Offset, Length, SendContext);
+    }
+    bool SendTemplate(
+        MSH3_HEADER_TEMPLATE* Template,
+        const MSH3_BUFFER* SlotValues,
+        uint32_t SlotValueCount,
+        const void* Data = nullptr,
+        uint32_t DataLength = 0,
+        MSH3_REQUEST_SEND_FLAGS Flags = MSH3_REQUEST_SEND_FLAG_NONE,
+        void* SendContext = nullptr
+        ) noexcept {
+        return MsH3RequestSendTemplate(Handle, Flags, Template, SlotValues, SlotValueCount, Data, DataLength, SendContext);
+    }
+    bool SendShared(
+        const MSH3_HEADER* Headers,
+        size_t HeadersCount,
+        MSH3_SHARED_BUFFER* SharedBuffer,
+        MSH3_REQUEST_SEND_FLAGS Flags = MSH3_REQUEST_SEND_FLAG_NONE,
+        void* SendContext = nullptr
+        ) noexcept {
+        return MsH3RequestSendShared(Handle, Flags, Headers, HeadersCount, SharedBuffer, SendContext);
+    }
+#endif
     void Shutdown(
         MSH3_REQUEST_SHUTDOWN_FLAGS Flags,
         uint64_t _AbortError = 0
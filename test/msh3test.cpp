@@ -10,6 +10,7 @@
 
 #include "msquic/src/inc/msquic.h" // For MsQuic parameter constants and types
 #include "msh3.hpp"
+#include "lib/msh3_frame.hpp" // Header only, for frame reader unit tests
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
@@ -20,7 +21,9 @@
 #include <algorithm> // For std::min
 #include <thread> // For watchdog timer thread
 #include <chrono> // For timing
+#include <ctime> // For CPU time (std::clock)
 #include <atomic> // For thread communication
+#include <memory> // For std::unique_ptr
 
 // Global flags for command line options
 bool g_Verbose = false;
@@ -192,6 +195,11 @@ const char* ToString(MSH3_REQUEST_EVENT_TYPE Type) {
         case MSH3_REQUEST_EVENT_SEND_COMPLETE: return "SEND_COMPLETE";
         case MSH3_REQUEST_EVENT_SEND_SHUTDOWN_COMPLETE: return "SEND_SHUTDOWN_COMPLETE";
         case MSH3_REQUEST_EVENT_PEER_RECEIVE_ABORTED: return "PEER_RECEIVE_ABORTED";
+        case MSH3_REQUEST_EVENT_SEND_COMPLETE_BATCH: return "SEND_COMPLETE_BATCH";
+        case MSH3_REQUEST_EVENT_WRITABLE: return "WRITABLE";
+        case MSH3_REQUEST_EVENT_DATA_RECEIVED_V: return "DATA_RECEIVED_V";
+        case MSH3_REQUEST_EVENT_HEADERS_COMPLETE: return "HEADERS_COMPLETE";
+        case MSH3_REQUEST_EVENT_BODY_SIZE_HINT: return "BODY_SIZE_HINT";
         default: return "UNKNOWN";
     }
 }
@@ -226,8 +234,36 @@ struct TestRequest : public MsH3Request {
     uint64_t TotalDataReceived = 0;         // Total data received in bytes
     bool PeerSendComplete = false;          // Flag to track if peer send was gracefully completed
     bool PeerSendAborted = false;           // Flag to track if peer send was aborted
+    uint64_t PeerSendAbortError = 0;
     bool HandleReceivesAsync = false;
     bool CompleteAsyncReceivesInline = false;
+    MsH3Waitable<void*> LatestSendComplete; // Signal with the context of the latest completed send
+    std::atomic_uint32_t SendCompletes {0}; // SEND_COMPLETE events
+    bool LastSendCanceled = false;
+    MsH3Waitable<bool> Writable;            // Signal when sends are accepted again after backpressure
+    uint32_t SendCompleteBatches = 0;
+    std::vector<void*> BatchedSendContexts; // From all SEND_COMPLETE_BATCH events
+    bool StoreReceivedData = false;         // Copy received data into ReceivedData
+    uint32_t VectoredReceives = 0;          // DATA_RECEIVED_V events
+    uint32_t MaxVectoredBufferCount = 0;    // Most buffers in one DATA_RECEIVED_V event
+    std::string ReceivedData;
+    struct RetainedData { uint64_t Id; const uint8_t* Data; uint32_t Length; uint64_t Offset; };
+    bool RetainReceives = false;            // Retain all received data, released by the test
+    std::mutex RetainedLock;
+    std::vector<RetainedData> Retained;     // Not yet taken by the test
+    std::vector<std::pair<const MSH3_HEADER*, uint32_t>> HeaderSections; // From HEADERS_COMPLETE events
+    std::vector<MSH3_PSEUDO_HEADERS> SectionPseudoHeaders; // From HEADERS_COMPLETE events that had any
+    MSH3_PSEUDO_HEADERS CapturedPseudo {};  // Read from each header's callback, with copies
+    std::string CapturedPath, CapturedAuthority, CapturedScheme; // of the views only valid there
+    MsH3Request* CloseOnHeader = nullptr;   // Closed from the callback for CloseOnHeaderName
+    std::string CloseOnHeaderName;
+    bool ReceiveToFile = false;             // Set the receive file on the first header
+    MSH3_FILE ReceiveFile;
+    uint64_t ReceiveFileOffset = 0;
+    bool ReceiveFileSet = false;
+    uint32_t BodySizeHints = 0;
+    uint64_t BodySizeHint = UINT64_MAX;
+    uint64_t DataReceivedBeforeHint = 0;
 
     // Helper to get the first header by name
     StoredHeader* GetHeaderByName(const char* name, size_t nameLength) {
@@ -281,9 +317,35 @@ struct TestRequest : public MsH3Request {
             // Save the header data
             ctx->Headers.emplace_back(
                 header->Name, header->NameLength, header->Value, header->ValueLength);
+            if (ctx->ReceiveToFile && !ctx->ReceiveFileSet) {
+                ctx->ReceiveFileSet = Request->SetReceiveFile(ctx->ReceiveFile, ctx->ReceiveFileOffset);
+            }
+            if (Request->GetPseudoHeaders(&ctx->CapturedPseudo)) {
+                auto& Pseudo = ctx->CapturedPseudo;
+                ctx->CapturedPath.assign(Pseudo.Path ? Pseudo.Path : "", Pseudo.PathLength);
+                ctx->CapturedAuthority.assign(Pseudo.Authority ? Pseudo.Authority : "", Pseudo.AuthorityLength);
+                ctx->CapturedScheme.assign(Pseudo.Scheme ? Pseudo.Scheme : "", Pseudo.SchemeLength);
+            }
+            if (ctx->CloseOnHeader && ctx->Headers.back().Name == ctx->CloseOnHeaderName) {
+                ctx->CloseOnHeader->Close(); // Waits on the worker when not called on it
+                ctx->CloseOnHeader = nullptr;
+            }
 
             LOG("%s Processed header: '%s'\n", ctx->Role, ctx->Headers.back().Name.c_str());
 
+        } else if (Event->Type == MSH3_REQUEST_EVENT_HEADERS_COMPLETE) {
+            LOG("%s Header section: %u headers\n", ctx->Role, Event->HEADERS_COMPLETE.HeaderCount);
+            ctx->HeaderSections.emplace_back(
+                Event->HEADERS_COMPLETE.Headers, Event->HEADERS_COMPLETE.HeaderCount);
+            if (Event->HEADERS_COMPLETE.PseudoHeaders) {
+                ctx->SectionPseudoHeaders.push_back(*Event->HEADERS_COMPLETE.PseudoHeaders);
+            }
+            for (uint32_t i = 0; i < Event->HEADERS_COMPLETE.HeaderCount; ++i) {
+                const MSH3_HEADER& header = Event->HEADERS_COMPLETE.Headers[i];
+                ctx->Headers.emplace_back(
+                    header.Name, header.NameLength, header.Value, header.ValueLength);
+            }
+
         } else if (Event->Type == MSH3_REQUEST_EVENT_DATA_RECEIVED) {
             LOG("%s Data received: %u bytes\n", ctx->Role, Event->DATA_RECEIVED.Length);
             if (!ctx->AllHeadersReceived.Get()) {
@@ -292,7 +354,18 @@ struct TestRequest : public MsH3Request {
                 ctx->AllHeadersReceived.Set(true);
             }
 
+            if (ctx->RetainReceives) {
+                auto Id = Request->RetainReceive();
+                if (Id != 0) {
+                    std::lock_guard<std::mutex> Lock(ctx->RetainedLock);
+                    ctx->Retained.push_back(
+                        {Id, Event->DATA_RECEIVED.Data, Event->DATA_RECEIVED.Length, ctx->TotalDataReceived});
+                }
+            }
             ctx->TotalDataReceived += Event->DATA_RECEIVED.Length;
+            if (ctx->StoreReceivedData) {
+                ctx->ReceivedData.append((const char*)Event->DATA_RECEIVED.Data, Event->DATA_RECEIVED.Length);
+            }
             ctx->LatestDataReceived.Set(Event->DATA_RECEIVED.Length);
 
             if (ctx->HandleReceivesAsync) {
@@ -303,6 +376,34 @@ struct TestRequest : public MsH3Request {
                 return MSH3_STATUS_PENDING;
             }
 
+        } else if (Event->Type == MSH3_REQUEST_EVENT_DATA_RECEIVED_V) {
+            LOG("%s Vectored data received: %u buffers, %llu bytes\n", ctx->Role,
+                Event->DATA_RECEIVED_V.BufferCount, (unsigned long long)Event->DATA_RECEIVED_V.TotalLength);
+            if (!ctx->AllHeadersReceived.Get()) {
+                LOG("%s Request headers complete\n", ctx->Role);
+                ctx->AllHeadersReceived.Set(true);
+            }
+
+            ctx->VectoredReceives++;
+            if (Event->DATA_RECEIVED_V.BufferCount > ctx->MaxVectoredBufferCount) {
+                ctx->MaxVectoredBufferCount = Event->DATA_RECEIVED_V.BufferCount;
+            }
+            for (uint32_t i = 0; i < Event->DATA_RECEIVED_V.BufferCount; ++i) {
+                const MSH3_BUFFER& Buffer = Event->DATA_RECEIVED_V.Buffers[i];
+                ctx->TotalDataReceived += Buffer.Length;
+                if (ctx->StoreReceivedData) {
+                    ctx->ReceivedData.append((const char*)Buffer.Buffer, Buffer.Length);
+                }
+            }
+            ctx->LatestDataReceived.Set((uint32_t)Event->DATA_RECEIVED_V.TotalLength);
+
+            if (ctx->HandleReceivesAsync) {
+                if (ctx->CompleteAsyncReceivesInline) {
+                    Request->CompleteReceive((uint32_t)Event->DATA_RECEIVED_V.TotalLength);
+                }
+                return MSH3_STATUS_PENDING;
+            }
+
         } else if (Event->Type == MSH3_REQUEST_EVENT_PEER_SEND_SHUTDOWN) {
             if (!ctx->AllHeadersReceived.Get()) {
                 // Signal that all headers have been received (since data always comes after headers)
@@ -312,9 +413,15 @@ struct TestRequest : public MsH3Request {
             ctx->PeerSendComplete = true;
             ctx->AllDataReceived.Set(true);
 
+        } else if (Event->Type == MSH3_REQUEST_EVENT_BODY_SIZE_HINT) {
+            ctx->BodySizeHints++;
+            ctx->BodySizeHint = Event->BODY_SIZE_HINT.ContentLength;
+            ctx->DataReceivedBeforeHint = ctx->TotalDataReceived;
+
         } else if (Event->Type == MSH3_REQUEST_EVENT_PEER_SEND_ABORTED) {
             // Handle case where request completes without data
             ctx->PeerSendAborted = true;
+            ctx->PeerSendAbortError = Event->PEER_SEND_ABORTED.ErrorCode;
             if (!ctx->AllHeadersReceived.Get()) {
                 // Signal that all headers have been received (since data always comes after headers)
                 LOG("%s Request headers complete\n", ctx->Role);
@@ -337,6 +444,18 @@ struct TestRequest : public MsH3Request {
             if (!ctx->AllDataSent.Get()) {
                 ctx->AllDataSent.Set(true);
             }
+        } else if (Event->Type == MSH3_REQUEST_EVENT_SEND_COMPLETE) {
+            ctx->LastSendCanceled = Event->SEND_COMPLETE.Canceled;
+            ctx->SendCompletes++;
+            ctx->LatestSendComplete.Set(Event->SEND_COMPLETE.ClientContext);
+        } else if (Event->Type == MSH3_REQUEST_EVENT_WRITABLE) {
+            ctx->Writable.Set(true);
+        } else if (Event->Type == MSH3_REQUEST_EVENT_SEND_COMPLETE_BATCH) {
+            ctx->SendCompleteBatches++;
+            ctx->BatchedSendContexts.insert(
+                ctx->BatchedSendContexts.end(),
+                Event->SEND_COMPLETE_BATCH.ClientContexts,
+                Event->SEND_COMPLETE_BATCH.ClientContexts + Event->SEND_COMPLETE_BATCH.Count);
         }
 
         return MSH3_STATUS_SUCCESS;
@@ -373,6 +492,9 @@ struct TestConnection : public MsH3Connection {
 
 struct TestServer : public MsH3Listener {
     bool AutoConfigure; // Automatically configure the server
+    bool AutoRespond {false}; // Send a full response to each request as it arrives
+    bool ReceiveToFile {false}; // Write each request's body to ReceiveFile
+    MSH3_FILE ReceiveFile;
     MsH3Configuration Configuration;
     MsH3Waitable<TestConnection*> NewConnection;
     MsH3Waitable<TestRequest*> NewRequest;
@@ -433,6 +555,13 @@ struct TestServer : public MsH3Listener {
         LOG("SERVER ConnectionEvent: %s\n", ToString(Event->Type));
         if (Event->Type == MSH3_CONNECTION_EVENT_NEW_REQUEST) {
             auto Request = new (std::nothrow) TestRequest(Event->NEW_REQUEST.Request, CleanUpAutoDelete);
+            if (Request && pThis->ReceiveToFile) { // Before any of the request is received
+                Request->ReceiveToFile = true;
+                Request->ReceiveFile = pThis->ReceiveFile;
+            }
+            if (Request && pThis->AutoRespond) {
+                Request->Send(ResponseHeaders, ResponseHeadersCount, ResponseData, sizeof(ResponseData), MSH3_REQUEST_SEND_FLAG_FIN);
+            }
             pThis->NewRequest.Set(Request);
         }
         return MSH3_STATUS_SUCCESS;
@@ -489,6 +618,68 @@ struct TestClient : public TestConnection {
     }
 };
 
+//
+// The common setup for single request tests: a client connected to a server,
+// with one request sent and accepted. Configure Request before calling Start.
+//
+struct TestRequestFixture {
+    MsH3Api Api;
+    TestServer Server;
+    TestClient Client;
+    TestRequest Request;
+    TestRequest* ServerRequest {nullptr};
+    TestRequestFixture(const MSH3_SETTINGS* ServerSettings = nullptr, const MSH3_SETTINGS* ClientSettings = nullptr) noexcept
+        : Server(Api, ServerSettings), Client(Api, ClientSettings), Request(Client) { }
+    bool Start(const MSH3_HEADER* Headers = RequestHeaders, size_t HeadersCount = RequestHeadersCount) noexcept {
+        VERIFY(Api.IsValid());
+        VERIFY(Server.IsValid());
+        VERIFY(Client.IsValid());
+        VERIFY(Request.IsValid());
+        VERIFY(Request.Send(Headers, HeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+        VERIFY_SUCCESS(Client.Start());
+        VERIFY(Server.WaitForConnection());
+        VERIFY(Client.Connected.WaitFor());
+        VERIFY(Server.NewRequest.WaitFor());
+        ServerRequest = Server.NewRequest.Get();
+        return true;
+    }
+    // Connects first, then sends the request with SendRequest().
+    template<typename SendFn>
+    bool StartWith(SendFn SendRequest) noexcept {
+        VERIFY(Api.IsValid());
+        VERIFY(Server.IsValid());
+        VERIFY(Client.IsValid());
+        VERIFY(Request.IsValid());
+        VERIFY_SUCCESS(Client.Start());
+        VERIFY(Server.WaitForConnection());
+        VERIFY(Client.Connected.WaitFor());
+        VERIFY(SendRequest());
+        VERIFY(Server.NewRequest.WaitFor());
+        ServerRequest = Server.NewRequest.Get();
+        return true;
+    }
+    // Sends ResponseHeaders, then Body in ChunkSize sends, finishing with FIN if Fin.
+    bool Respond(const std::string& Body, uint32_t ChunkSize, MSH3_REQUEST_SEND_FLAGS ChunkFlags = MSH3_REQUEST_SEND_FLAG_NONE, bool Fin = true) noexcept {
+        VERIFY(ServerRequest->Send(ResponseHeaders, ResponseHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_DELAY_SEND));
+        for (size_t Offset = 0; Offset < Body.size(); Offset += ChunkSize) {
+            const uint32_t Length = (uint32_t)std::min<size_t>(ChunkSize, Body.size() - Offset);
+            const bool Last = Offset + Length == Body.size();
+            auto Flags = Last && Fin ? MSH3_REQUEST_SEND_FLAG_FIN : ChunkFlags;
+            VERIFY(ServerRequest->Send(nullptr, 0, Body.data() + Offset, Length, Flags));
+        }
+        return true;
+    }
+};
+
+// ChunkCount runs of ChunkSize bytes, each a different letter from First.
+std::string TestBody(uint32_t ChunkCount, uint32_t ChunkSize, char First = 'A') {
+    std::string Body;
+    for (uint32_t i = 0; i < ChunkCount; ++i) {
+        Body.append(ChunkSize, (char)(First + i % 26));
+    }
+    return Body;
+}
+
 DEF_TEST(Handshake) {
     MsH3Api Api; VERIFY(Api.IsValid());
     TestServer Server(Api); VERIFY(Server.IsValid());
@@ -988,6 +1179,46 @@ DEF_TEST(GetQuicParamBasic) {
     return true;
 }
 
+DEF_TEST(PoolStatistics) {
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+    auto ServerConnection = Server.NewConnection.Get();
+
+    MSH3_CONNECTION_POOL_STATISTICS Stats;
+    uint32_t BufferLength = 1;
+    VERIFY(MSH3_FAILED(ServerConnection->GetParam(MSH3_PARAM_CONNECTION_POOL_STATISTICS, &BufferLength, &Stats)));
+    VERIFY(BufferLength == sizeof(Stats));
+
+    // Sequential sends reuse the same pooled send context
+    const uint32_t RequestCount = 10;
+    for (uint32_t i = 0; i < RequestCount; ++i) {
+        Server.NewRequest.Reset();
+        TestRequest Request(Client);
+        VERIFY(Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+        VERIFY(Server.NewRequest.WaitFor());
+        auto ServerRequest = Server.NewRequest.Get();
+        VERIFY(ServerRequest->Send(ResponseHeaders, ResponseHeadersCount, ResponseData, sizeof(ResponseData), MSH3_REQUEST_SEND_FLAG_FIN));
+        VERIFY(ServerRequest->LatestSendComplete.WaitFor());
+        VERIFY(Request.AllDataReceived.WaitFor());
+    }
+
+    VERIFY_SUCCESS(ServerConnection->GetParam(MSH3_PARAM_CONNECTION_POOL_STATISTICS, &BufferLength, &Stats));
+    VERIFY(BufferLength == sizeof(Stats));
+    VERIFY(Stats.AppSend.AllocCount >= RequestCount);
+    VERIFY(Stats.AppSend.InUseCount == 0);
+    VERIFY(Stats.AppSend.HeapAllocCount < Stats.AppSend.AllocCount);
+    VERIFY(Stats.AppSend.CachedCount >= 1);
+    VERIFY(Stats.AppSend.HeapFreeCount == 0);
+
+    Client.Shutdown();
+    VERIFY(Client.ShutdownComplete.WaitFor());
+    return true;
+}
+
 DEF_TEST(DynamicQPackSettings) {
     // Create settings with DynamicQPackEnabled
     MSH3_SETTINGS settings = {0};
@@ -1033,6 +1264,1489 @@ DEF_TEST(DynamicQPackSettings) {
     return true;
 }
 
+DEF_TEST(SendVectored) {
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    TestRequest Request(Client); VERIFY(Request.IsValid());
+    Request.StoreReceivedData = true;
+    VERIFY(Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+    VERIFY(Server.NewRequest.WaitFor());
+    auto ServerRequest = Server.NewRequest.Get();
+
+    // More buffers than fit inline in the send context, including an empty one
+    const char Body[] = "{\"id\":\"0123456789\"}";
+    std::vector<MSH3_BUFFER> Buffers;
+    Buffers.push_back({ 7, (const uint8_t*)Body });
+    Buffers.push_back({ 0, nullptr });
+    for (uint32_t i = 7; i < sizeof(Body) - 1; ++i) {
+        Buffers.push_back({ 1, (const uint8_t*)Body + i });
+    }
+    VERIFY(ServerRequest->SendV(ResponseHeaders, ResponseHeadersCount, Buffers.data(), (uint32_t)Buffers.size(), MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY(Request.AllDataReceived.WaitFor());
+    VERIFY(Request.PeerSendComplete);
+    VERIFY(Request.ReceivedData == Body);
+    return true;
+}
+
+DEF_TEST(SendDeclaredBodyLength) {
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    TestRequest Request(Client); VERIFY(Request.IsValid());
+    Request.StoreReceivedData = true;
+    VERIFY(Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+    VERIFY(Server.NewRequest.WaitFor());
+    auto ServerRequest = Server.NewRequest.Get();
+
+    // Stream the body in chunks under a single DATA frame
+    const char Chunk[] = "0123456789";
+    const uint32_t ChunkLength = sizeof(Chunk) - 1;
+    VERIFY(ServerRequest->SetSendBodyLength(3 * ChunkLength));
+    VERIFY(ServerRequest->Send(ResponseHeaders, ResponseHeadersCount, Chunk, ChunkLength));
+    VERIFY(!ServerRequest->SetSendBodyLength(ChunkLength)); // Already in progress
+    VERIFY(ServerRequest->Send(nullptr, 0, Chunk, ChunkLength));
+    VERIFY(!ServerRequest->Send(nullptr, 0, Chunk, ChunkLength - 1, MSH3_REQUEST_SEND_FLAG_FIN)); // Short
+    VERIFY(!ServerRequest->Send(nullptr, 0, Chunk, sizeof(Chunk))); // Too long
+    VERIFY(ServerRequest->Send(nullptr, 0, Chunk, ChunkLength, MSH3_REQUEST_SEND_FLAG_FIN));
+
+    VERIFY(Request.AllDataReceived.WaitFor());
+    VERIFY(Request.PeerSendComplete);
+    VERIFY(Request.ReceivedData == std::string(Chunk) + Chunk + Chunk);
+    return true;
+}
+
+DEF_TEST(HeaderTemplate) {
+    const MSH3_HEADER TemplateHeaders[] = {
+        { ":status", 7, "200", 3 },
+        { "content-type", 12, "application/json", 16 },
+        { "content-length", 14, nullptr, 0 },   // Slot
+        { "x-request-id", 12, nullptr, 0 },     // Slot
+        { "server", 6, "msh3", 4 },
+    };
+    MsH3HeaderTemplate Template(TemplateHeaders, ARRAYSIZE(TemplateHeaders));
+    VERIFY(Template.IsValid());
+
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+
+    const char Body[] = "{\"status\":\"ok\"}";
+    const char BodyLength[] = "15";
+    for (uint32_t i = 0; i < 2; ++i) {
+        Server.NewRequest.Reset();
+        TestRequest Request(Client); VERIFY(Request.IsValid());
+        Request.StoreReceivedData = true;
+        VERIFY(Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+        VERIFY(Server.NewRequest.WaitFor());
+        auto ServerRequest = Server.NewRequest.Get();
+
+        const std::string RequestId = "req-" + std::to_string(i);
+        const MSH3_BUFFER SlotValues[] = {
+            { (uint32_t)sizeof(BodyLength) - 1, (const uint8_t*)BodyLength },
+            { (uint32_t)RequestId.length(), (const uint8_t*)RequestId.c_str() },
+        };
+        VERIFY(!ServerRequest->SendTemplate(Template, SlotValues, 1)); // Wrong slot count
+        VERIFY(ServerRequest->SendTemplate(Template, SlotValues, ARRAYSIZE(SlotValues), Body, sizeof(Body) - 1, MSH3_REQUEST_SEND_FLAG_FIN));
+
+        VERIFY(Request.AllDataReceived.WaitFor());
+        VERIFY(Request.HasExpectedHeaderCount(ARRAYSIZE(TemplateHeaders)));
+        VERIFY(Request.GetStatusCode() == 200);
+        auto Header = Request.GetHeaderByName("content-length", 14);
+        VERIFY(Header && Header->Value == BodyLength);
+        Header = Request.GetHeaderByName("x-request-id", 12);
+        VERIFY(Header && Header->Value == RequestId);
+        Header = Request.GetHeaderByName("server", 6);
+        VERIFY(Header && Header->Value == "msh3");
+        VERIFY(Request.ReceivedData == Body);
+        VERIFY(Request.ShutdownComplete.WaitFor());
+    }
+    return true;
+}
+
+DEF_TEST(SharedBufferFanOut) {
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+
+    const uint32_t RequestCount = 3;
+    std::unique_ptr<TestRequest> Requests[RequestCount];
+    TestRequest* ServerRequests[RequestCount];
+    for (uint32_t i = 0; i < RequestCount; ++i) {
+        Server.NewRequest.Reset();
+        Requests[i].reset(new TestRequest(Client));
+        VERIFY(Requests[i]->IsValid());
+        Requests[i]->StoreReceivedData = true;
+        VERIFY(Requests[i]->Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+        VERIFY(Server.NewRequest.WaitFor());
+        ServerRequests[i] = Server.NewRequest.Get();
+    }
+
+    // The application's reference is dropped as soon as the sends are queued
+    const char Snapshot[] = "{\"event\":\"snapshot\",\"seq\":42}";
+    auto SharedBuffer = new MsH3SharedBuffer(Snapshot, sizeof(Snapshot) - 1);
+    VERIFY(SharedBuffer->IsValid());
+    for (uint32_t i = 0; i < RequestCount; ++i) {
+        VERIFY(ServerRequests[i]->SendShared(ResponseHeaders, ResponseHeadersCount, *SharedBuffer, MSH3_REQUEST_SEND_FLAG_FIN));
+    }
+    delete SharedBuffer;
+
+    for (uint32_t i = 0; i < RequestCount; ++i) {
+        VERIFY(Requests[i]->AllDataReceived.WaitFor());
+        VERIFY(Requests[i]->ReceivedData == Snapshot);
+    }
+    return true;
+}
+
+DEF_TEST(SendFile) {
+    // Several chunks worth of data, not a multiple of the chunk size
+    std::string Contents;
+    for (uint32_t i = 0; i < 100000; ++i) {
+        Contents.push_back((char)('a' + i % 26));
+    }
+    std::unique_ptr<FILE, decltype(&fclose)> Temp(tmpfile(), fclose);
+    VERIFY(Temp != nullptr);
+    VERIFY(fwrite(Contents.data(), 1, Contents.size(), Temp.get()) == Contents.size());
+    VERIFY(fflush(Temp.get()) == 0);
+#ifdef _WIN32
+    const MSH3_FILE File = (MSH3_FILE)_get_osfhandle(_fileno(Temp.get()));
+#else
+    const MSH3_FILE File = fileno(Temp.get());
+#endif
+
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    TestRequest Request(Client); VERIFY(Request.IsValid());
+    Request.StoreReceivedData = true;
+    VERIFY(Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+    VERIFY(Server.NewRequest.WaitFor());
+    auto ServerRequest = Server.NewRequest.Get();
+
+    const uint64_t Offset = 10, Length = Contents.size() - 20;
+    VERIFY(!ServerRequest->SendFile(ResponseHeaders, ResponseHeadersCount, File, Offset, 0)); // Empty
+    VERIFY(ServerRequest->SendFile(ResponseHeaders, ResponseHeadersCount, File, Offset, Length, MSH3_REQUEST_SEND_FLAG_FIN, &Contents));
+
+    VERIFY(ServerRequest->LatestSendComplete.WaitFor());
+    VERIFY(ServerRequest->LatestSendComplete.Get() == &Contents);
+    VERIFY(!ServerRequest->LastSendCanceled);
+    VERIFY(Request.AllDataReceived.WaitFor());
+    VERIFY(Request.PeerSendComplete);
+    VERIFY(Request.ReceivedData == Contents.substr(Offset, Length));
+    return true;
+}
+
+DEF_TEST(ReceiveFile) {
+    std::string Body;
+    for (uint32_t i = 0; i < 1000000; ++i) {
+        Body.push_back((char)('a' + i % 23));
+    }
+    std::unique_ptr<FILE, decltype(&fclose)> Temp(tmpfile(), fclose);
+    VERIFY(Temp != nullptr);
+#ifdef _WIN32
+    const MSH3_FILE File = (MSH3_FILE)_get_osfhandle(_fileno(Temp.get()));
+#else
+    const MSH3_FILE File = fileno(Temp.get());
+#endif
+    const uint64_t Offset = 5;
+
+    TestRequestFixture Test;
+    auto& Request = Test.Request;
+    Request.ReceiveToFile = true;
+    Request.ReceiveFile = File;
+    Request.ReceiveFileOffset = Offset;
+    VERIFY(Test.Start());
+    VERIFY(Test.Respond(Body, 100000)); // Several sends, so the body spans many receive events
+
+    VERIFY(Request.AllDataReceived.WaitFor(5000));
+    VERIFY(Request.ReceiveFileSet);
+    VERIFY(Request.PeerSendComplete);
+    VERIFY(Request.TotalDataReceived == 0); // Nothing indicated
+    VERIFY(!Request.SetReceiveFile(File, 0)); // Already set
+
+    std::string Written(Body.size(), '\0');
+    VERIFY(fseek(Temp.get(), (long)Offset, SEEK_SET) == 0);
+    VERIFY(fread(&Written[0], 1, Written.size(), Temp.get()) == Written.size());
+    VERIFY(fgetc(Temp.get()) == EOF);
+    VERIFY(Written == Body);
+    return true;
+}
+
+DEF_TEST(ReceiveFileUpload) {
+    // The server writes an uploaded request body to the file
+    const std::string Body = TestBody(40, 25000);
+    std::unique_ptr<FILE, decltype(&fclose)> Temp(tmpfile(), fclose);
+    VERIFY(Temp != nullptr);
+#ifdef _WIN32
+    const MSH3_FILE File = (MSH3_FILE)_get_osfhandle(_fileno(Temp.get()));
+#else
+    const MSH3_FILE File = fileno(Temp.get());
+#endif
+
+    TestRequestFixture Test;
+    auto& Request = Test.Request;
+    Test.Server.ReceiveToFile = true;
+    Test.Server.ReceiveFile = File;
+    VERIFY(Test.StartWith([&]() {
+        return Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0);
+    }));
+    const uint32_t SendLength = 100000;
+    for (size_t Sent = 0; Sent < Body.size(); Sent += SendLength) {
+        const bool Last = Sent + SendLength >= Body.size();
+        VERIFY(Request.Send(nullptr, 0, Body.data() + Sent, (uint32_t)std::min<size_t>(SendLength, Body.size() - Sent),
+            Last ? MSH3_REQUEST_SEND_FLAG_FIN : MSH3_REQUEST_SEND_FLAG_NONE));
+    }
+
+    auto ServerRequest = Test.ServerRequest;
+    VERIFY(ServerRequest->AllDataReceived.WaitFor(5000));
+    VERIFY(ServerRequest->ReceiveFileSet);
+    VERIFY(ServerRequest->PeerSendComplete);
+    VERIFY(ServerRequest->TotalDataReceived == 0); // Nothing indicated
+    VERIFY(ServerRequest->Send(ResponseHeaders, ResponseHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY(Request.AllDataReceived.WaitFor());
+    VERIFY(Request.GetStatusCode() == 200);
+
+    std::string Written(Body.size(), '\0');
+    VERIFY(fseek(Temp.get(), 0, SEEK_SET) == 0);
+    VERIFY(fread(&Written[0], 1, Written.size(), Temp.get()) == Written.size());
+    VERIFY(fgetc(Temp.get()) == EOF);
+    VERIFY(Written == Body);
+    return true;
+}
+
+DEF_TEST(SendBuffered) {
+    MSH3_SETTINGS Settings = {0};
+    Settings.IsSet.SendBufferingThreshold = 1;
+    Settings.SendBufferingThreshold = 1024;
+
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api, &Settings); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    TestRequest Request(Client); VERIFY(Request.IsValid());
+    Request.StoreReceivedData = true;
+    VERIFY(Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+    VERIFY(Server.NewRequest.WaitFor());
+    auto ServerRequest = Server.NewRequest.Get();
+
+    // The buffer is reused right away, before the send could have completed
+    char Reply[] = "{\"status\":\"ok\"}";
+    const std::string Expected = std::string(Reply) + Reply;
+    VERIFY(ServerRequest->Send(ResponseHeaders, ResponseHeadersCount, Reply, sizeof(Reply) - 1));
+    memset(Reply, 'x', sizeof(Reply) - 1);
+
+    // Only the copied send with an AppContext indicates SEND_COMPLETE. Sends
+    // complete in order, so the first one has completed by then too.
+    int Marker;
+    memcpy(Reply, Expected.data(), sizeof(Reply) - 1);
+    VERIFY(ServerRequest->Send(nullptr, 0, Reply, sizeof(Reply) - 1, MSH3_REQUEST_SEND_FLAG_FIN, &Marker));
+    memset(Reply, 'x', sizeof(Reply) - 1);
+    VERIFY(ServerRequest->LatestSendComplete.WaitFor());
+    VERIFY(ServerRequest->LatestSendComplete.Get() == &Marker);
+    VERIFY(ServerRequest->SendCompletes == 1);
+
+    VERIFY(Request.AllDataReceived.WaitFor());
+    VERIFY(Request.PeerSendComplete);
+    VERIFY(Request.ReceivedData == Expected);
+    VERIFY(ServerRequest->SendCompletes == 1);
+    return true;
+}
+
+DEF_TEST(SendCoalesced) {
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    TestRequest Request(Client); VERIFY(Request.IsValid());
+    Request.StoreReceivedData = true;
+    VERIFY(Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+    VERIFY(Server.NewRequest.WaitFor());
+    auto ServerRequest = Server.NewRequest.Get();
+
+    // Many tiny messages, from a buffer that is reused for each write
+    std::string Expected;
+    VERIFY(ServerRequest->Send(ResponseHeaders, ResponseHeadersCount));
+    for (uint32_t i = 0; i < 500; ++i) {
+        char Message[32];
+        auto Length = snprintf(Message, sizeof(Message), "{\"seq\":%u}\n", i);
+        VERIFY(ServerRequest->Send(nullptr, 0, Message, (uint32_t)Length, MSH3_REQUEST_SEND_FLAG_COALESCE));
+        Expected.append(Message, Length);
+        if (i == 250) VERIFY(ServerRequest->Flush());
+    }
+
+    // A write bigger than the coalesce buffer is still copied, with no completion
+    std::string Big(10000, 'b');
+    VERIFY(ServerRequest->Send(nullptr, 0, Big.data(), (uint32_t)Big.size(), MSH3_REQUEST_SEND_FLAG_COALESCE, &Big));
+    Expected += Big;
+    Big.assign(Big.size(), 'x');
+
+    const char Last[] = "{\"done\":true}\n"; // Flushes the pending writes first
+    VERIFY(ServerRequest->Send(nullptr, 0, Last, sizeof(Last) - 1, MSH3_REQUEST_SEND_FLAG_FIN, (void*)Last));
+    Expected += Last;
+
+    VERIFY(Request.AllDataReceived.WaitFor());
+    VERIFY(Request.PeerSendComplete);
+    VERIFY(Request.ReceivedData == Expected);
+    VERIFY(ServerRequest->LatestSendComplete.WaitFor());
+    VERIFY(ServerRequest->LatestSendComplete.Get() == Last);
+    VERIFY(ServerRequest->SendCompletes == 1); // Only the final, uncoalesced send
+    return true;
+}
+
+DEF_TEST(SendCompleteBatch) {
+    MSH3_SETTINGS Settings = {0};
+    Settings.IsSet.SendCompleteBatchEnabled = 1;
+    Settings.SendCompleteBatchEnabled = 1;
+
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api, &Settings); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    TestRequest Request(Client); VERIFY(Request.IsValid());
+    VERIFY(Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+    VERIFY(Server.NewRequest.WaitFor());
+    auto ServerRequest = Server.NewRequest.Get();
+
+    const uint32_t SendCount = 100;
+    static const char Chunk[] = "0123456789abcdef";
+    VERIFY(ServerRequest->Send(ResponseHeaders, ResponseHeadersCount));
+    for (uint32_t i = 0; i < SendCount; ++i) {
+        VERIFY(ServerRequest->Send(
+            nullptr, 0, Chunk, sizeof(Chunk) - 1,
+            i == SendCount - 1 ? MSH3_REQUEST_SEND_FLAG_FIN : MSH3_REQUEST_SEND_FLAG_NONE,
+            (void*)(uintptr_t)(i + 1)));
+    }
+
+    // All completions are reported before the send shutdown completes
+    VERIFY(Request.AllDataReceived.WaitFor());
+    VERIFY(ServerRequest->AllDataSent.WaitFor());
+    VERIFY(!ServerRequest->LatestSendComplete.Get()); // None reported individually
+    VERIFY(ServerRequest->BatchedSendContexts.size() == SendCount);
+    VERIFY(ServerRequest->SendCompleteBatches != 0);
+    for (uint32_t i = 0; i < SendCount; ++i) {
+        VERIFY(ServerRequest->BatchedSendContexts[i] == (void*)(uintptr_t)(i + 1));
+    }
+    return true;
+}
+
+DEF_TEST(SendBackpressure) {
+    MSH3_SETTINGS Settings = {0};
+    Settings.IsSet.SendWatermarks = 1;
+    Settings.SendHighWatermarkPercent = 100;
+    Settings.SendLowWatermarkPercent = 50;
+
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api, &Settings); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    TestRequest Request(Client); VERIFY(Request.IsValid());
+    VERIFY(Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+    VERIFY(Server.NewRequest.WaitFor());
+    auto ServerRequest = Server.NewRequest.Get();
+
+    // Queue data until the high watermark rejects a send
+    static uint8_t Chunk[0x4000];
+    uint64_t TotalSent = 0;
+    VERIFY(ServerRequest->Send(ResponseHeaders, ResponseHeadersCount));
+    for (uint32_t i = 0; ServerRequest->Send(nullptr, 0, Chunk, sizeof(Chunk)); ++i) {
+        VERIFY(i < 1000);
+        TotalSent += sizeof(Chunk);
+    }
+    VERIFY(ServerRequest->Send(nullptr, 0)); // Zero-length sends aren't held back
+    VERIFY(ServerRequest->Writable.WaitFor(2000));
+
+    // Refill, then finish with a FIN-only send, which isn't held back either
+    for (uint32_t i = 0; ServerRequest->Send(nullptr, 0, Chunk, sizeof(Chunk)); ++i) {
+        VERIFY(i < 1000);
+        TotalSent += sizeof(Chunk);
+    }
+    VERIFY(ServerRequest->Send(nullptr, 0, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+
+    VERIFY(Request.AllDataReceived.WaitFor(2000));
+    VERIFY(Request.PeerSendComplete);
+    VERIFY(Request.TotalDataReceived == TotalSent);
+    return true;
+}
+
+bool SendLargeHeaders(bool DynamicQPack) {
+    MSH3_SETTINGS Settings = {0};
+    Settings.IsSet.DynamicQPackEnabled = 1;
+    Settings.DynamicQPackEnabled = DynamicQPack ? 1 : 0;
+
+    // Several KB of headers, well past the inline header buffer
+    const uint32_t ExtraCount = 24;
+    std::vector<std::string> Names, Values;
+    for (uint32_t i = 0; i < ExtraCount; ++i) {
+        Names.push_back("x-large-header-" + std::to_string(i));
+        Values.push_back(std::string(120, (char)('a' + i % 26)));
+    }
+    std::vector<MSH3_HEADER> Headers(ResponseHeaders, ResponseHeaders + ResponseHeadersCount);
+    for (uint32_t i = 0; i < ExtraCount; ++i) {
+        Headers.push_back({ Names[i].c_str(), Names[i].size(), Values[i].c_str(), Values[i].size() });
+    }
+
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api, &Settings); VERIFY(Server.IsValid());
+    TestClient Client(Api, &Settings); VERIFY(Client.IsValid());
+    TestRequest Request(Client); VERIFY(Request.IsValid());
+    VERIFY(Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+    VERIFY(Server.NewRequest.WaitFor());
+    auto ServerRequest = Server.NewRequest.Get();
+    VERIFY(ServerRequest->Send(Headers.data(), Headers.size(), ResponseData, sizeof(ResponseData), MSH3_REQUEST_SEND_FLAG_FIN));
+
+    VERIFY(Request.AllDataReceived.WaitFor());
+    VERIFY(Request.TotalDataReceived == sizeof(ResponseData));
+    VERIFY(Request.Headers.size() == Headers.size());
+    for (uint32_t i = 0; i < ExtraCount; ++i) {
+        auto Header = Request.GetHeaderByName(Names[i].c_str(), Names[i].size());
+        VERIFY(Header != nullptr);
+        VERIFY(Header->Value == Values[i]);
+    }
+    return true;
+}
+
+DEF_TEST(SendLargeHeaders) {
+    return SendLargeHeaders(false);
+}
+
+DEF_TEST(SendLargeHeadersDynamic) {
+    return SendLargeHeaders(true);
+}
+
+DEF_TEST(SendLargeHeaderValue) {
+    // One value well past the old 512 byte staging limit, and one laid out
+    // contiguously after its name so it's encoded in place
+    const std::string LargeValue(3000, 'v');
+    const char Contiguous[] = "x-contiguousin-place-value";
+    std::vector<MSH3_HEADER> Headers(ResponseHeaders, ResponseHeaders + ResponseHeadersCount);
+    Headers.push_back({ "x-large-value", 13, LargeValue.c_str(), LargeValue.size() });
+    Headers.push_back({ Contiguous, 12, Contiguous + 12, sizeof(Contiguous) - 13 });
+
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    TestRequest Request(Client); VERIFY(Request.IsValid());
+    VERIFY(Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+    VERIFY(Server.NewRequest.WaitFor());
+    auto ServerRequest = Server.NewRequest.Get();
+    VERIFY(ServerRequest->Send(Headers.data(), Headers.size(), ResponseData, sizeof(ResponseData), MSH3_REQUEST_SEND_FLAG_FIN));
+
+    VERIFY(Request.AllDataReceived.WaitFor());
+    VERIFY(Request.Headers.size() == Headers.size());
+    auto Header = Request.GetHeaderByName("x-large-value", 13);
+    VERIFY(Header != nullptr);
+    VERIFY(Header->Value == LargeValue);
+    Header = Request.GetHeaderByName("x-contiguous", 12);
+    VERIFY(Header != nullptr);
+    VERIFY(Header->Value == "in-place-value");
+    return true;
+}
+
+bool ReceiveLargeHeader(bool DynamicQPack, uint32_t MaxFieldSectionSize) {
+    // Bigger than the pooled decode buffer, so decode space has to grow
+    const std::string LargeValue(20000, 'w');
+    std::vector<MSH3_HEADER> Headers(ResponseHeaders, ResponseHeaders + ResponseHeadersCount);
+    Headers.push_back({ "x-large-value", 13, LargeValue.c_str(), LargeValue.size() });
+
+    MSH3_SETTINGS ClientSettings = {0};
+    ClientSettings.IsSet.DynamicQPackEnabled = DynamicQPack;
+    ClientSettings.DynamicQPackEnabled = DynamicQPack;
+    ClientSettings.IsSet.MaxFieldSectionSize = MaxFieldSectionSize != 0;
+    ClientSettings.MaxFieldSectionSize = MaxFieldSectionSize;
+    MSH3_SETTINGS ServerSettings = {0};
+    ServerSettings.IsSet.DynamicQPackEnabled = DynamicQPack;
+    ServerSettings.DynamicQPackEnabled = DynamicQPack;
+
+    TestRequestFixture Test(&ServerSettings, &ClientSettings);
+    auto& Request = Test.Request;
+    VERIFY(Test.Start());
+    // May fail once the client has aborted the stream
+    (void)Test.ServerRequest->Send(Headers.data(), Headers.size(), ResponseData, sizeof(ResponseData), MSH3_REQUEST_SEND_FLAG_FIN);
+
+    VERIFY(Request.AllDataReceived.WaitFor());
+    auto Header = Request.GetHeaderByName("x-large-value", 13);
+    if (MaxFieldSectionSize != 0 && MaxFieldSectionSize < LargeValue.size()) {
+        VERIFY(Header == nullptr); // Section rejected, and the stream with it
+        VERIFY(Request.PeerSendAborted);
+        VERIFY(Request.PeerSendAbortError == 0x107); // H3_EXCESSIVE_LOAD
+        VERIFY(Request.TotalDataReceived == 0);
+        return true;
+    }
+    VERIFY(Header != nullptr);
+    VERIFY(Header->Value == LargeValue);
+    VERIFY(Request.GetStatusCode() == 200);
+    VERIFY(Request.TotalDataReceived == sizeof(ResponseData));
+    return true;
+}
+
+DEF_TEST(ReceiveLargeHeader) {
+    return ReceiveLargeHeader(false, 0);
+}
+
+DEF_TEST(ReceiveLargeHeaderDynamic) {
+    return ReceiveLargeHeader(true, 0);
+}
+
+DEF_TEST(ReceiveHeaderOverMaxFieldSection) {
+    return ReceiveLargeHeader(false, 8192);
+}
+
+DEF_TEST(ConcurrentRequestSend) {
+    // Many app threads open and send requests on one connection at once
+    const uint32_t ThreadCount = 8, RequestsPerThread = 16;
+    MSH3_SETTINGS Settings = {0};
+    Settings.IsSet.DynamicQPackEnabled = 1;
+    Settings.DynamicQPackEnabled = 1;
+
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api, &Settings); VERIFY(Server.IsValid());
+    Server.AutoRespond = true;
+    TestClient Client(Api, &Settings); VERIFY(Client.IsValid());
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+
+    std::atomic<uint32_t> Succeeded{0};
+    std::vector<std::thread> Threads;
+    for (uint32_t t = 0; t < ThreadCount; ++t) {
+        Threads.emplace_back([&, t]() {
+            // A per-thread header value, so the encoder's dynamic table is
+            // updated from several threads
+            const std::string Value = "thread-" + std::to_string(t);
+            MSH3_HEADER Headers[RequestHeadersCount + 1];
+            memcpy(Headers, RequestHeaders, sizeof(RequestHeaders));
+            Headers[RequestHeadersCount] = { "x-thread", 8, Value.c_str(), Value.size() };
+            for (uint32_t i = 0; i < RequestsPerThread; ++i) {
+                TestRequest Request(Client);
+                if (!Request.IsValid() ||
+                    !Request.Send(Headers, ARRAYSIZE(Headers), nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN) ||
+                    !Request.AllDataReceived.WaitFor() ||
+                    Request.GetStatusCode() != 200 ||
+                    Request.TotalDataReceived != sizeof(ResponseData)) {
+                    return;
+                }
+                Succeeded++;
+            }
+        });
+    }
+    for (auto& Thread : Threads) {
+        Thread.join();
+    }
+    VERIFY(Succeeded == ThreadCount * RequestsPerThread);
+    return true;
+}
+
+struct BatchRequestContext {
+    uint64_t DataReceived {0};
+    std::atomic<uint32_t>* CompleteCount;
+    MsH3Waitable<bool>* AllComplete;
+    uint32_t ExpectedCount;
+};
+
+MSH3_STATUS
+MSH3_CALL
+BatchRequestCallback(
+    MSH3_REQUEST* /* Request */,
+    void* Context,
+    MSH3_REQUEST_EVENT* Event
+    )
+{
+    auto ctx = (BatchRequestContext*)Context;
+    if (Event->Type == MSH3_REQUEST_EVENT_DATA_RECEIVED) {
+        ctx->DataReceived += Event->DATA_RECEIVED.Length;
+    } else if (Event->Type == MSH3_REQUEST_EVENT_PEER_SEND_SHUTDOWN) {
+        if (ctx->DataReceived == sizeof(ResponseData) &&
+            ++*ctx->CompleteCount == ctx->ExpectedCount) {
+            ctx->AllComplete->Set(true);
+        }
+    }
+    return MSH3_STATUS_SUCCESS;
+}
+
+DEF_TEST(SubmitBatch) {
+    const uint32_t RequestCount = 32;
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api); VERIFY(Server.IsValid());
+    Server.AutoRespond = true;
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+
+    std::atomic<uint32_t> CompleteCount{0};
+    MsH3Waitable<bool> AllComplete;
+    BatchRequestContext Contexts[RequestCount];
+    MSH3_REQUEST_SUBMISSION Submissions[RequestCount + 1] = {};
+    for (uint32_t i = 0; i < RequestCount; ++i) {
+        Contexts[i].CompleteCount = &CompleteCount;
+        Contexts[i].AllComplete = &AllComplete;
+        Contexts[i].ExpectedCount = RequestCount;
+        Submissions[i].Handler = BatchRequestCallback;
+        Submissions[i].Context = &Contexts[i];
+        Submissions[i].SendFlags = MSH3_REQUEST_SEND_FLAG_FIN;
+        Submissions[i].Headers = RequestHeaders;
+        Submissions[i].HeadersCount = RequestHeadersCount;
+    }
+    // An invalid entry (no headers) fails alone
+    Submissions[RequestCount].Handler = BatchRequestCallback;
+    Submissions[RequestCount].Context = &Contexts[0];
+
+    VERIFY(Client.SubmitBatch(Submissions, RequestCount + 1) == RequestCount);
+    VERIFY(Submissions[RequestCount].Request == nullptr);
+    VERIFY(AllComplete.WaitFor(2000));
+    for (uint32_t i = 0; i < RequestCount; ++i) {
+        VERIFY(Submissions[i].Request != nullptr);
+        VERIFY(Contexts[i].DataReceived == sizeof(ResponseData));
+        MsH3RequestClose(Submissions[i].Request);
+    }
+    return true;
+}
+
+DEF_TEST(SubmitBatchLastFails) {
+    // The last entry fails to encode, so the one before it must flush the
+    // delayed sends instead
+    const uint32_t RequestCount = 8;
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api); VERIFY(Server.IsValid());
+    Server.AutoRespond = true;
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+
+    const std::string TooLong(70000, 'x'); // Over lsxpack's string limit
+    const MSH3_HEADER BadHeaders[] = {
+        { ":method", 7, "GET", 3 },
+        { ":path", 5, TooLong.data(), TooLong.size() },
+        { ":scheme", 7, "https", 5 },
+        { ":authority", 10, "localhost", 9 },
+    };
+    std::atomic<uint32_t> CompleteCount{0};
+    MsH3Waitable<bool> AllComplete;
+    BatchRequestContext Contexts[RequestCount];
+    MSH3_REQUEST_SUBMISSION Submissions[RequestCount + 1] = {};
+    for (uint32_t i = 0; i < RequestCount + 1; ++i) {
+        Contexts[i % RequestCount].CompleteCount = &CompleteCount;
+        Contexts[i % RequestCount].AllComplete = &AllComplete;
+        Contexts[i % RequestCount].ExpectedCount = RequestCount;
+        Submissions[i].Handler = BatchRequestCallback;
+        Submissions[i].Context = &Contexts[i % RequestCount];
+        Submissions[i].SendFlags = MSH3_REQUEST_SEND_FLAG_FIN;
+        Submissions[i].Headers = RequestHeaders;
+        Submissions[i].HeadersCount = RequestHeadersCount;
+    }
+    Submissions[RequestCount].Headers = BadHeaders;
+    Submissions[RequestCount].HeadersCount = sizeof(BadHeaders)/sizeof(MSH3_HEADER);
+
+    VERIFY(Client.SubmitBatch(Submissions, RequestCount + 1) == RequestCount);
+    VERIFY(Submissions[RequestCount].Request == nullptr);
+    VERIFY(AllComplete.WaitFor(2000)); // Not left delayed
+    for (uint32_t i = 0; i < RequestCount; ++i) {
+        VERIFY(Submissions[i].Request != nullptr);
+        MsH3RequestClose(Submissions[i].Request);
+    }
+    return true;
+}
+
+DEF_TEST(ReceiveAsyncResumable) {
+    // Many small DATA frames, so receive events carry several frames that
+    // must be resumed after each pended indication
+    const uint32_t ChunkSize = 700;
+    const std::string Body = TestBody(64, ChunkSize);
+
+    TestRequestFixture Test;
+    auto& Request = Test.Request;
+    Request.HandleReceivesAsync = true;
+    Request.StoreReceivedData = true;
+    VERIFY(Test.Start());
+    VERIFY(Test.Respond(Body, ChunkSize));
+
+    // Complete each pended receive from this thread, which resumes parsing
+    while (Request.TotalDataReceived < Body.size()) {
+        VERIFY(Request.LatestDataReceived.WaitFor(2000));
+        auto Length = Request.LatestDataReceived.GetAndReset();
+        Request.CompleteReceive(Length);
+    }
+    VERIFY(Request.AllDataReceived.WaitFor(2000));
+    VERIFY(Request.GetStatusCode() == 200);
+    VERIFY(Request.ReceivedData == Body);
+    return true;
+}
+
+DEF_TEST(ReceiveAsyncTrailers) {
+    // Trailers packed behind pended DATA are decoded on the thread completing
+    // the receive, while the worker feeds the same (dynamic) QPACK decoder
+    const uint32_t ChunkSize = 700;
+    const std::string Body = TestBody(16, ChunkSize);
+    const std::string Checksum(200, 'c');
+    const MSH3_HEADER Trailers[] = {
+        { "x-checksum", 10, Checksum.data(), Checksum.size() },
+    };
+
+    MSH3_SETTINGS Settings = {0};
+    Settings.IsSet.DynamicQPackEnabled = 1;
+    Settings.DynamicQPackEnabled = 1;
+    TestRequestFixture Test(&Settings, &Settings);
+    auto& Request = Test.Request;
+    Request.HandleReceivesAsync = true;
+    Request.StoreReceivedData = true;
+    VERIFY(Test.Start());
+    VERIFY(Test.Respond(Body, ChunkSize, MSH3_REQUEST_SEND_FLAG_DELAY_SEND, false));
+    VERIFY(Test.ServerRequest->Send(Trailers, 1, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+
+    // Complete from this thread, not the connection's worker
+    while (Request.TotalDataReceived < Body.size()) {
+        VERIFY(Request.LatestDataReceived.WaitFor(2000));
+        Request.CompleteReceive(Request.LatestDataReceived.GetAndReset());
+    }
+    VERIFY(Request.AllDataReceived.WaitFor(2000));
+    VERIFY(Request.GetStatusCode() == 200);
+    VERIFY(Request.ReceivedData == Body);
+    auto Trailer = Request.GetHeaderByName("x-checksum", 10);
+    VERIFY(Trailer != nullptr);
+    VERIFY(Trailer->Value == Checksum);
+    return true;
+}
+
+DEF_TEST(ReceiveAsyncTrailersClose) {
+    // Another request is closed from the trailer's callback, on the thread
+    // completing the receive, which mustn't hold the decoder against the worker
+    const uint32_t ChunkSize = 700;
+    const std::string Body = TestBody(16, ChunkSize);
+    const MSH3_HEADER Trailers[] = {
+        { "x-checksum", 10, "abc123", 6 },
+    };
+
+    MSH3_SETTINGS Settings = {0};
+    Settings.IsSet.DynamicQPackEnabled = 1;
+    Settings.DynamicQPackEnabled = 1;
+    TestRequestFixture Test(&Settings, &Settings);
+    auto& Request = Test.Request;
+    Request.HandleReceivesAsync = true;
+    VERIFY(Test.Start());
+    TestRequest Other(Test.Client); VERIFY(Other.IsValid());
+    Test.Server.NewRequest.Reset();
+    VERIFY(Other.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY(Test.Server.NewRequest.WaitFor()); // Started, so closing it involves the worker
+    Request.CloseOnHeader = &Other;
+    Request.CloseOnHeaderName = "x-checksum";
+    VERIFY(Test.Respond(Body, ChunkSize, MSH3_REQUEST_SEND_FLAG_DELAY_SEND, false));
+    VERIFY(Test.ServerRequest->Send(Trailers, 1, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+
+    while (Request.TotalDataReceived < Body.size()) {
+        VERIFY(Request.LatestDataReceived.WaitFor(2000));
+        Request.CompleteReceive(Request.LatestDataReceived.GetAndReset());
+    }
+    VERIFY(Request.AllDataReceived.WaitFor(2000));
+    VERIFY(Request.GetHeaderByName("x-checksum", 10) != nullptr);
+    VERIFY(!Other.IsValid()); // Closed
+    return true;
+}
+
+bool ReceiveVectored(bool Async) {
+    // Many small DATA frames, so one receive pass yields many payload slices
+    const uint32_t ChunkCount = 64, ChunkSize = 300;
+    const std::string Body = TestBody(ChunkCount, ChunkSize, 'a');
+
+    MSH3_SETTINGS Settings = {0};
+    Settings.IsSet.ReceiveVectoredEnabled = 1;
+    Settings.ReceiveVectoredEnabled = 1;
+
+    TestRequestFixture Test(nullptr, &Settings);
+    auto& Request = Test.Request;
+    Request.HandleReceivesAsync = Async;
+    Request.StoreReceivedData = true;
+    VERIFY(Test.Start());
+    VERIFY(Test.Respond(Body, ChunkSize, MSH3_REQUEST_SEND_FLAG_DELAY_SEND));
+
+    if (Async) {
+        while (Request.TotalDataReceived < Body.size()) {
+            VERIFY(Request.LatestDataReceived.WaitFor(2000));
+            Request.CompleteReceive(Request.LatestDataReceived.GetAndReset());
+        }
+    }
+    VERIFY(Request.AllDataReceived.WaitFor(2000));
+    VERIFY(Request.GetStatusCode() == 200);
+    VERIFY(Request.ReceivedData == Body);
+    VERIFY(Request.VectoredReceives != 0);
+    VERIFY(Request.VectoredReceives < ChunkCount); // Slices were batched
+    VERIFY(Request.MaxVectoredBufferCount > 1);
+    return true;
+}
+
+DEF_TEST(ReceiveVectored) {
+    return ReceiveVectored(false);
+}
+
+DEF_TEST(ReceiveVectoredAsync) {
+    return ReceiveVectored(true);
+}
+
+DEF_TEST(ReceiveRetained) {
+    // More body than the stream receive window, so it only completes if
+    // data released out of order is completed back to MsQuic in order
+    const uint32_t ChunkSize = 1000;
+    const std::string Body = TestBody(256, ChunkSize);
+
+    MSH3_SETTINGS Settings = {0};
+    Settings.IsSet.ReceiveRetainEnabled = 1;
+    Settings.ReceiveRetainEnabled = 1;
+
+    TestRequestFixture Test(nullptr, &Settings);
+    auto& Request = Test.Request;
+    Request.RetainReceives = true;
+    VERIFY(Test.Start());
+    VERIFY(Test.Respond(Body, ChunkSize));
+    VERIFY(Request.RetainReceive() == 0); // Not from outside the callback
+
+    // Copy out and release retained data from this thread, newest first
+    std::string Reassembled(Body.size(), '\0');
+    uint64_t Released = 0;
+    auto Deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (Released < Body.size()) {
+        VERIFY(std::chrono::steady_clock::now() < Deadline);
+        std::vector<TestRequest::RetainedData> Taken;
+        {
+            std::lock_guard<std::mutex> Lock(Request.RetainedLock);
+            Taken.swap(Request.Retained);
+        }
+        if (Taken.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        for (auto It = Taken.rbegin(); It != Taken.rend(); ++It) {
+            VERIFY(It->Offset + It->Length <= Reassembled.size());
+            memcpy(&Reassembled[It->Offset], It->Data, It->Length);
+            Request.ReleaseReceive(It->Id);
+            Request.ReleaseReceive(It->Id); // Ignored
+            Released += It->Length;
+        }
+    }
+    VERIFY(Request.AllDataReceived.WaitFor(2000));
+    VERIFY(Request.GetStatusCode() == 200);
+    VERIFY(Request.TotalDataReceived == Body.size());
+    VERIFY(Reassembled == Body);
+    return true;
+}
+
+bool HeadersComplete(bool DynamicQPack) {
+    std::string LargeValue(1500, 'v');
+    const MSH3_HEADER Headers[] = {
+        { ":status", 7, "200", 3 },
+        { "content-type", 12, "application/json", 16 },
+        { "x-large", 7, LargeValue.data(), LargeValue.size() },
+        { "x-server", 8, "msh3-test-server", 16 },
+    };
+    const size_t HeadersCount = sizeof(Headers)/sizeof(MSH3_HEADER);
+    const MSH3_HEADER Trailers[] = {
+        { "x-checksum", 10, "abc123", 6 },
+    };
+
+    MSH3_SETTINGS ClientSettings = {0};
+    ClientSettings.IsSet.HeadersCompleteEnabled = 1;
+    ClientSettings.HeadersCompleteEnabled = 1;
+    ClientSettings.IsSet.DynamicQPackEnabled = DynamicQPack;
+    ClientSettings.DynamicQPackEnabled = DynamicQPack;
+    MSH3_SETTINGS ServerSettings = {0};
+    ServerSettings.IsSet.DynamicQPackEnabled = DynamicQPack;
+    ServerSettings.DynamicQPackEnabled = DynamicQPack;
+
+    TestRequestFixture Test(&ServerSettings, &ClientSettings);
+    auto& Request = Test.Request;
+    VERIFY(Test.Start());
+    VERIFY(Test.ServerRequest->Send(Headers, HeadersCount, ResponseData, sizeof(ResponseData)));
+    VERIFY(Test.ServerRequest->Send(Trailers, 1, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    VERIFY(Request.AllDataReceived.WaitFor());
+
+    // One event per section, still valid after the callbacks returned
+    VERIFY(Request.HeaderSections.size() == 2);
+    VERIFY(Request.HeaderSections[0].second == HeadersCount);
+    for (size_t i = 0; i < HeadersCount; ++i) {
+        const MSH3_HEADER& Header = Request.HeaderSections[0].first[i];
+        VERIFY(Header.NameLength == Headers[i].NameLength);
+        VERIFY(memcmp(Header.Name, Headers[i].Name, Header.NameLength) == 0);
+        VERIFY(Header.ValueLength == Headers[i].ValueLength);
+        VERIFY(memcmp(Header.Value, Headers[i].Value, Header.ValueLength) == 0);
+    }
+    VERIFY(Request.HeaderSections[1].second == 1);
+    VERIFY(Request.HeaderSections[1].first[0].ValueLength == 6);
+    VERIFY(memcmp(Request.HeaderSections[1].first[0].Value, "abc123", 6) == 0);
+    VERIFY(Request.SectionPseudoHeaders.size() == 1); // Not for the trailers
+    VERIFY(Request.SectionPseudoHeaders[0].Status == 200);
+    VERIFY(Request.SectionPseudoHeaders[0].Method == MSH3_METHOD_NONE);
+    VERIFY(Request.GetStatusCode() == 200);
+    VERIFY(Request.TotalDataReceived == sizeof(ResponseData));
+    return true;
+}
+
+DEF_TEST(HeadersComplete) {
+    return HeadersComplete(false);
+}
+
+DEF_TEST(HeadersCompleteDynamic) {
+    return HeadersComplete(true);
+}
+
+DEF_TEST(HeadersCompleteArenaFull) {
+    // Each section fits the max field section size, but together they don't
+    // fit the 256 KB header arena
+    const std::string LargeValue(60000, 'a');
+    const MSH3_HEADER Trailers[] = {
+        { "x-large", 7, LargeValue.data(), LargeValue.size() },
+    };
+    const uint32_t SectionCount = 6;
+
+    MSH3_SETTINGS ClientSettings = {0};
+    ClientSettings.IsSet.HeadersCompleteEnabled = 1;
+    ClientSettings.HeadersCompleteEnabled = 1;
+    TestRequestFixture Test(nullptr, &ClientSettings);
+    auto& Request = Test.Request;
+    VERIFY(Test.Start());
+    VERIFY(Test.ServerRequest->Send(ResponseHeaders, ResponseHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_DELAY_SEND));
+    for (uint32_t i = 0; i < SectionCount; ++i) {
+        // Later sends may fail once the client has aborted the stream
+        (void)Test.ServerRequest->Send(Trailers, 1, nullptr, 0,
+            i + 1 == SectionCount ? MSH3_REQUEST_SEND_FLAG_FIN : MSH3_REQUEST_SEND_FLAG_DELAY_SEND);
+    }
+    VERIFY(Request.AllDataReceived.WaitFor());
+    VERIFY(Request.PeerSendAborted);
+    VERIFY(Request.PeerSendAbortError == 0x107); // H3_EXCESSIVE_LOAD
+    VERIFY(!Request.PeerSendComplete);
+    VERIFY(Request.HeaderSections.size() > 1);
+    VERIFY(Request.HeaderSections.size() < SectionCount + 1);
+    return true;
+}
+
+DEF_TEST(PseudoHeaders) {
+    const MSH3_HEADER PurgeHeaders[] = {
+        { ":method", 7, "PURGE", 5 },
+        { ":path", 5, "/items/7?all=1", 14 },
+        { ":scheme", 7, "https", 5 },
+        { ":authority", 10, "example.test:4433", 17 },
+        { "user-agent", 10, "msh3test", 8 },
+    };
+    const MSH3_HEADER NotFoundHeaders[] = {
+        { ":status", 7, "404", 3 },
+        { "content-type", 12, "text/plain", 10 },
+    };
+
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+
+    // Methods from the static table, and one that isn't
+    const struct { const MSH3_HEADER* Headers; size_t Count; MSH3_METHOD Method; } Requests[] = {
+        { RequestHeaders, RequestHeadersCount, MSH3_METHOD_GET },
+        { PurgeHeaders, sizeof(PurgeHeaders)/sizeof(MSH3_HEADER), MSH3_METHOD_OTHER },
+    };
+    for (auto& Sent : Requests) {
+        TestRequest Request(Client); VERIFY(Request.IsValid());
+        MSH3_PSEUDO_HEADERS Pseudo;
+        VERIFY(!Request.GetPseudoHeaders(&Pseudo));
+        VERIFY(Request.Send(Sent.Headers, Sent.Count, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+        VERIFY(Server.NewRequest.WaitFor());
+        auto ServerRequest = Server.NewRequest.Get();
+        Server.NewRequest.Reset();
+        VERIFY(ServerRequest->AllHeadersReceived.WaitFor());
+        VERIFY(ServerRequest->CapturedPseudo.Method == Sent.Method);
+        VERIFY(ServerRequest->CapturedPseudo.Status == 0);
+        VERIFY(ServerRequest->CapturedPath == Sent.Headers[1].Value);
+        VERIFY(ServerRequest->CapturedScheme == "https");
+        VERIFY(ServerRequest->CapturedAuthority == Sent.Headers[3].Value);
+        VERIFY(ServerRequest->GetPseudoHeaders(&Pseudo)); // Views are dropped after the section
+        VERIFY(Pseudo.Method == Sent.Method && Pseudo.Path == nullptr);
+
+        VERIFY(ServerRequest->Send(NotFoundHeaders, 2, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+        VERIFY(Request.AllDataReceived.WaitFor());
+        VERIFY(Request.CapturedPseudo.Status == 404);
+        VERIFY(Request.CapturedPseudo.Method == MSH3_METHOD_NONE);
+        VERIFY(Request.CapturedPseudo.Path == nullptr);
+    }
+    return true;
+}
+
+enum ContentLengthRequestSend {
+    ContentLengthSendHeaders,
+    ContentLengthSendTemplate,      // With a fixed :method
+    ContentLengthSendTemplateSlot,  // With :method in a slot
+    ContentLengthSubmitBatch,
+};
+
+// Responds with ResponseData, declaring DeclaredLength in content-length, to a
+// request sent with Via.
+bool ContentLength(const char* DeclaredLength, bool ExpectValid, bool HeadRequest = false, ContentLengthRequestSend Via = ContentLengthSendHeaders) {
+    const MSH3_HEADER Headers[] = {
+        { ":status", 7, "200", 3 },
+        { "content-type", 12, "text/plain", 10 },
+        { "content-length", 14, DeclaredLength, strlen(DeclaredLength) },
+    };
+    MSH3_HEADER SentRequestHeaders[RequestHeadersCount];
+    memcpy(SentRequestHeaders, RequestHeaders, sizeof(RequestHeaders));
+    if (HeadRequest) SentRequestHeaders[0] = { ":method", 7, "HEAD", 4 };
+    const MSH3_BUFFER MethodSlot = { (uint32_t)SentRequestHeaders[0].ValueLength, (const uint8_t*)SentRequestHeaders[0].Value };
+    MSH3_HEADER TemplateHeaders[RequestHeadersCount];
+    memcpy(TemplateHeaders, SentRequestHeaders, sizeof(SentRequestHeaders));
+    if (Via == ContentLengthSendTemplateSlot) TemplateHeaders[0] = { ":method", 7, nullptr, 0 };
+    MsH3HeaderTemplate Template(TemplateHeaders, RequestHeadersCount);
+    VERIFY(Template.IsValid());
+
+    MSH3_SETTINGS ClientSettings = {0};
+    ClientSettings.IsSet.ContentLengthEnabled = 1;
+    ClientSettings.ContentLengthEnabled = 1;
+
+    TestRequestFixture Test(nullptr, &ClientSettings);
+    std::atomic<uint32_t> BatchCompleteCount{0};
+    MsH3Waitable<bool> BatchComplete;
+    BatchRequestContext BatchContext;
+    BatchContext.CompleteCount = &BatchCompleteCount;
+    BatchContext.AllComplete = &BatchComplete;
+    BatchContext.ExpectedCount = 1;
+    std::unique_ptr<TestRequest> BatchRequest;
+    if (Via == ContentLengthSendHeaders) {
+        VERIFY(Test.Start(SentRequestHeaders, RequestHeadersCount));
+    } else if (Via == ContentLengthSubmitBatch) {
+        VERIFY(Test.StartWith([&]() {
+            MSH3_REQUEST_SUBMISSION Submission = {};
+            Submission.Handler = BatchRequestCallback;
+            Submission.Context = &BatchContext;
+            Submission.SendFlags = MSH3_REQUEST_SEND_FLAG_FIN;
+            Submission.Headers = SentRequestHeaders;
+            Submission.HeadersCount = RequestHeadersCount;
+            if (Test.Client.SubmitBatch(&Submission, 1) != 1) return false;
+            BatchRequest.reset(new TestRequest(Submission.Request, CleanUpManual)); // Before the response
+            return true;
+        }));
+    } else {
+        VERIFY(Test.StartWith([&]() {
+            return Test.Request.SendTemplate(
+                Template, &MethodSlot, Via == ContentLengthSendTemplateSlot ? 1 : 0,
+                nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN);
+        }));
+    }
+    auto& Request = BatchRequest ? *BatchRequest : Test.Request;
+    if (HeadRequest) {
+        VERIFY(Test.ServerRequest->Send(Headers, 3, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+    } else {
+        VERIFY(Test.ServerRequest->Send(Headers, 3, ResponseData, sizeof(ResponseData) - 1, MSH3_REQUEST_SEND_FLAG_FIN));
+    }
+    VERIFY(Request.AllDataReceived.WaitFor());
+    VERIFY(Request.GetStatusCode() == 200);
+
+    if (!ExpectValid) {
+        VERIFY(Request.PeerSendAborted);
+        VERIFY(Request.PeerSendAbortError == 0x10E); // H3_MESSAGE_ERROR
+        VERIFY(!Request.PeerSendComplete);
+        return true;
+    }
+    VERIFY(Request.PeerSendComplete);
+    VERIFY(!Request.PeerSendAborted);
+    if (HeadRequest) {
+        VERIFY(Request.BodySizeHints == 0); // No body, whatever the content-length
+        VERIFY(Request.TotalDataReceived == 0);
+    } else {
+        VERIFY(Request.BodySizeHints == 1);
+        VERIFY(Request.BodySizeHint == sizeof(ResponseData) - 1);
+        VERIFY(Request.DataReceivedBeforeHint == 0);
+        VERIFY(Request.TotalDataReceived == sizeof(ResponseData) - 1);
+    }
+    return true;
+}
+
+DEF_TEST(ContentLengthHint) {
+    return ContentLength("13", true);
+}
+
+DEF_TEST(ContentLengthHeadRequest) {
+    return ContentLength("13", true, true);
+}
+
+DEF_TEST(ContentLengthHeadTemplate) {
+    return ContentLength("13", true, true, ContentLengthSendTemplate) &&
+        ContentLength("13", true, true, ContentLengthSendTemplateSlot) &&
+        ContentLength("13", true, false, ContentLengthSendTemplateSlot);
+}
+
+DEF_TEST(ContentLengthHeadBatch) {
+    return ContentLength("13", true, true, ContentLengthSubmitBatch);
+}
+
+DEF_TEST(ContentLengthTooShort) {
+    return ContentLength("5", false);
+}
+
+DEF_TEST(ContentLengthTooLong) {
+    return ContentLength("100", false);
+}
+
+DEF_TEST(ContentLengthInvalid) {
+    return ContentLength("13x", false);
+}
+
+void AppendVarInt(std::vector<uint8_t>& Out, uint64_t Value) {
+    if (Value < 0x40) {
+        Out.push_back((uint8_t)Value);
+    } else if (Value < 0x4000) {
+        Out.push_back((uint8_t)(0x40 | (Value >> 8))); Out.push_back((uint8_t)Value);
+    } else if (Value < 0x40000000) {
+        Out.push_back((uint8_t)(0x80 | (Value >> 24)));
+        for (int i = 2; i >= 0; --i) Out.push_back((uint8_t)(Value >> (8 * i)));
+    } else {
+        Out.push_back((uint8_t)(0xC0 | (Value >> 56)));
+        for (int i = 6; i >= 0; --i) Out.push_back((uint8_t)(Value >> (8 * i)));
+    }
+}
+
+struct TestFrame { uint64_t Type; std::vector<uint8_t> Payload; };
+
+std::vector<TestFrame> MakeTestFrames() {
+    std::vector<uint8_t> Settings;
+    AppendVarInt(Settings, 0x1); AppendVarInt(Settings, 4096);       // QPACK max table capacity
+    AppendVarInt(Settings, 0x6); AppendVarInt(Settings, 0x10000);    // Max field section size
+    AppendVarInt(Settings, 0x7); AppendVarInt(Settings, 100);        // QPACK blocked streams
+    AppendVarInt(Settings, 0x1f * 77 + 0x21); AppendVarInt(Settings, 0x123456789ULL); // Grease
+    std::vector<uint8_t> Large(5000);
+    for (size_t i = 0; i < Large.size(); ++i) Large[i] = (uint8_t)(i * 7);
+    return {
+        { 0x4, Settings },                      // SETTINGS
+        { 0x1f * 0x1000000ULL + 0x21, Large },  // Reserved type with an 8 byte varint
+        { 0x7, { 0x40, 0x10 } },                // GOAWAY
+        { 0xd, {} },                            // Empty
+    };
+}
+
+std::vector<uint8_t> EncodeTestFrames(const std::vector<TestFrame>& Frames) {
+    std::vector<uint8_t> Out;
+    for (auto& Frame : Frames) {
+        AppendVarInt(Out, Frame.Type);
+        AppendVarInt(Out, Frame.Payload.size());
+        Out.insert(Out.end(), Frame.Payload.begin(), Frame.Payload.end());
+    }
+    return Out;
+}
+
+// Feeds Data in chunks of ChunkSize and checks the frames read back
+bool ReadTestFrames(const std::vector<uint8_t>& Data, size_t ChunkSize, const std::vector<TestFrame>& Expected, bool (*IsBuffered)(uint64_t) = nullptr) {
+    MsH3pFrameReader Reader(0x4000, IsBuffered);
+    size_t FrameCount = 0;
+    for (size_t Offset = 0; Offset < Data.size(); Offset += ChunkSize) {
+        const uint8_t* Chunk = Data.data() + Offset;
+        uint32_t Length = (uint32_t)std::min(ChunkSize, Data.size() - Offset);
+        while (Length != 0) {
+            uint32_t Consumed = 0;
+            auto Result = Reader.Read(Chunk, Length, &Consumed);
+            VERIFY(Result != H3FrameReadError);
+            VERIFY(Consumed <= Length);
+            Chunk += Consumed; Length -= Consumed;
+            if (Result == H3FrameReadNeedMore) {
+                VERIFY(Length == 0);
+                break;
+            }
+            VERIFY(FrameCount < Expected.size());
+            auto& Frame = Expected[FrameCount++];
+            VERIFY(Reader.Type == Frame.Type);
+            VERIFY(Reader.PayloadLength == Frame.Payload.size());
+            VERIFY(Frame.Payload.empty() || memcmp(Reader.Payload, Frame.Payload.data(), Frame.Payload.size()) == 0);
+            if (ChunkSize >= Data.size()) { // Whole frames are returned in place
+                VERIFY(Frame.Payload.empty() || (Reader.Payload >= Data.data() && Reader.Payload < Data.data() + Data.size()));
+            }
+        }
+    }
+    VERIFY(FrameCount == Expected.size());
+    return true;
+}
+
+DEF_TEST(FrameReaderByteByByte) {
+    auto Frames = MakeTestFrames();
+    auto Data = EncodeTestFrames(Frames);
+    VERIFY(ReadTestFrames(Data, 1, Frames));
+    VERIFY(ReadTestFrames(Data, Data.size(), Frames));
+    for (size_t ChunkSize : { 2, 3, 7, 64, 1000, 4999 }) {
+        VERIFY(ReadTestFrames(Data, ChunkSize, Frames));
+    }
+    return true;
+}
+
+DEF_TEST(FrameReaderSplitAnywhere) {
+    // Two reads, split at every possible offset
+    auto Frames = MakeTestFrames();
+    Frames[1].Payload.resize(300);
+    auto Data = EncodeTestFrames(Frames);
+    for (size_t Split = 1; Split < Data.size(); ++Split) {
+        MsH3pFrameReader Reader(0x4000);
+        size_t FrameCount = 0;
+        const uint8_t* Parts[2] = { Data.data(), Data.data() + Split };
+        uint32_t Lengths[2] = { (uint32_t)Split, (uint32_t)(Data.size() - Split) };
+        for (int Part = 0; Part < 2; ++Part) {
+            const uint8_t* Chunk = Parts[Part];
+            uint32_t Length = Lengths[Part];
+            while (Length != 0) {
+                uint32_t Consumed = 0;
+                auto Result = Reader.Read(Chunk, Length, &Consumed);
+                VERIFY(Result != H3FrameReadError);
+                Chunk += Consumed; Length -= Consumed;
+                if (Result == H3FrameReadNeedMore) break;
+                VERIFY(FrameCount < Frames.size());
+                auto& Frame = Frames[FrameCount++];
+                VERIFY(Reader.Type == Frame.Type);
+                VERIFY(Reader.PayloadLength == Frame.Payload.size());
+                VERIFY(Frame.Payload.empty() || memcmp(Reader.Payload, Frame.Payload.data(), Frame.Payload.size()) == 0);
+            }
+        }
+        VERIFY(FrameCount == Frames.size());
+    }
+    return true;
+}
+
+bool IsTestControlFrame(uint64_t Type) { return Type == 0x4 || Type == 0x7 || Type == 0xd; }
+
+DEF_TEST(FrameReaderSkipUnknown) {
+    // Reserved frames are skipped without buffering, even over the max payload
+    auto Frames = MakeTestFrames();
+    std::vector<uint8_t> Grease(100000, 0x5A);
+    Frames.insert(Frames.begin() + 1, { 0x1f * 3 + 0x21, Grease });
+    Frames.push_back({ 0x21, Grease });
+    auto Data = EncodeTestFrames(Frames);
+    std::vector<TestFrame> Expected;
+    for (auto& Frame : Frames) {
+        if (IsTestControlFrame(Frame.Type)) Expected.push_back(Frame);
+    }
+    VERIFY(Expected.size() == 3);
+    for (size_t ChunkSize : { (size_t)1, (size_t)7, (size_t)4999, (size_t)65536, Data.size() }) {
+        VERIFY(ReadTestFrames(Data, ChunkSize, Expected, IsTestControlFrame));
+    }
+
+    // A known frame is still limited
+    std::vector<uint8_t> TooBig;
+    AppendVarInt(TooBig, 0x21);
+    AppendVarInt(TooBig, 0);
+    AppendVarInt(TooBig, 0x4);
+    AppendVarInt(TooBig, 0x4001);
+    MsH3pFrameReader Reader(0x4000, IsTestControlFrame);
+    uint32_t Consumed = 0;
+    VERIFY(Reader.Read(TooBig.data(), (uint32_t)TooBig.size(), &Consumed) == H3FrameReadError);
+    return true;
+}
+
+DEF_TEST(FrameReaderTooBig) {
+    std::vector<uint8_t> Data;
+    AppendVarInt(Data, 0x4);
+    AppendVarInt(Data, 0x4001);
+    MsH3pFrameReader Reader(0x4000);
+    for (size_t i = 0; i < Data.size(); ++i) {
+        uint32_t Consumed = 0;
+        auto Result = Reader.Read(Data.data() + i, 1, &Consumed);
+        VERIFY(Result == (i + 1 == Data.size() ? H3FrameReadError : H3FrameReadNeedMore));
+    }
+    uint32_t Consumed = 0;
+    VERIFY(Reader.Read(Data.data(), 1, &Consumed) == H3FrameReadError); // Stays failed
+    return true;
+}
+
+DEF_TEST(FrameScanner) {
+    auto Frames = MakeTestFrames();
+    Frames[1].Payload.resize(100);
+    for (uint64_t Type : { 0ULL, 0x3fULL, 0x40ULL, 0x3fffULL, 0x4000ULL, 0x3fffffffULL, 0x40000000ULL, 0x3fffffffffffffffULL }) {
+        Frames.push_back({ Type, std::vector<uint8_t>((size_t)(Type % 5), 0xAB) });
+    }
+    auto Data = EncodeTestFrames(Frames);
+
+    // The whole buffer, in batches of every size
+    for (uint32_t MaxFrames = 1; MaxFrames <= Frames.size() + 1; ++MaxFrames) {
+        std::vector<H3FrameRef> Refs(MaxFrames);
+        uint32_t Offset = 0;
+        size_t FrameCount = 0;
+        while (Offset < Data.size()) {
+            uint32_t Count = MsH3pScanFrames(Data.data(), (uint32_t)Data.size(), Offset, Refs.data(), MaxFrames);
+            VERIFY(Count != 0);
+            for (uint32_t i = 0; i < Count; ++i) {
+                VERIFY(Refs[i].HeaderOffset == Offset);
+                VERIFY(Refs[i].Type == Frames[FrameCount].Type);
+                VERIFY(Refs[i].Length == Frames[FrameCount].Payload.size());
+                Offset = Refs[i].PayloadOffset + (uint32_t)Refs[i].Length;
+                FrameCount++;
+            }
+        }
+        VERIFY(FrameCount == Frames.size());
+    }
+
+    // Truncated anywhere: only frames with complete headers, and the scan
+    // stops after the first payload that runs past the end
+    for (uint32_t Length = 0; Length < Data.size(); ++Length) {
+        H3FrameRef Refs[32];
+        uint32_t Count = MsH3pScanFrames(Data.data(), Length, 0, Refs, 32);
+        for (uint32_t i = 0; i < Count; ++i) {
+            VERIFY(Refs[i].Type == Frames[i].Type);
+            VERIFY(Refs[i].PayloadOffset <= Length);
+            if (i + 1 < Count) VERIFY(Refs[i].PayloadOffset + Refs[i].Length <= Length);
+        }
+    }
+    return true;
+}
+
+// The frame-at-a-time decoding the receive path used before scanning
+uint32_t DecodeFramesOneByOne(const uint8_t* Buffer, uint32_t Length, H3FrameRef* Frames, uint32_t MaxFrames) {
+    uint32_t Offset = 0, Count = 0;
+    while (Count < MaxFrames) {
+        H3FrameRef& Frame = Frames[Count];
+        Frame.HeaderOffset = Offset;
+        if (!MsH3pVarIntDecode(Length, Buffer, &Offset, &Frame.Type) ||
+            !MsH3pVarIntDecode(Length, Buffer, &Offset, &Frame.Length)) {
+            break;
+        }
+        Frame.PayloadOffset = Offset;
+        Count++;
+        if (Frame.Length > Length - Offset) break;
+        Offset += (uint32_t)Frame.Length;
+    }
+    return Count;
+}
+
+// Scans the whole buffer in batches of BatchSize frames
+uint32_t ScanAllFrames(const uint8_t* Buffer, uint32_t Length, H3FrameRef* Frames, uint32_t MaxFrames, uint32_t BatchSize) {
+    uint32_t Offset = 0, Total = 0, Count;
+    while (Total < MaxFrames &&
+           (Count = MsH3pScanFrames(Buffer, Length, Offset, Frames + Total, std::min(BatchSize, MaxFrames - Total))) != 0) {
+        Total += Count;
+        const auto& Last = Frames[Total - 1];
+        if (Last.Length > Length - Last.PayloadOffset) break;
+        Offset = Last.PayloadOffset + (uint32_t)Last.Length;
+    }
+    return Total;
+}
+
+DEF_TEST(FrameScanBenchmark) {
+    // Many small DATA frames per packet-sized buffer, the last one cut short
+    std::vector<uint8_t> Data;
+    while (Data.size() < 1200) {
+        const uint64_t PayloadLength = 16 + Data.size() % 70;
+        AppendVarInt(Data, 0x0);
+        AppendVarInt(Data, PayloadLength);
+        Data.resize(Data.size() + (size_t)PayloadLength, 0x5A);
+    }
+    Data.resize(1200);
+    const uint32_t Length = (uint32_t)Data.size(), Iterations = 200000, MaxFrames = 128;
+
+    // Both find the same frames
+    H3FrameRef Expected[MaxFrames], Scanned[MaxFrames];
+    const uint32_t ExpectedCount = DecodeFramesOneByOne(Data.data(), Length, Expected, MaxFrames);
+    VERIFY(ExpectedCount > 10 && ExpectedCount < MaxFrames);
+    for (uint32_t BatchSize : { 1u, 3u, 8u, MaxFrames }) {
+        VERIFY(ScanAllFrames(Data.data(), Length, Scanned, MaxFrames, BatchSize) == ExpectedCount);
+        for (uint32_t i = 0; i < ExpectedCount; ++i) {
+            VERIFY(Scanned[i].Type == Expected[i].Type);
+            VERIFY(Scanned[i].Length == Expected[i].Length);
+            VERIFY(Scanned[i].HeaderOffset == Expected[i].HeaderOffset);
+            VERIFY(Scanned[i].PayloadOffset == Expected[i].PayloadOffset);
+        }
+    }
+
+    uint64_t OneByOneSum = 0;
+    auto Start = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < Iterations; ++n) {
+        uint32_t Count = DecodeFramesOneByOne(Data.data(), Length, Expected, MaxFrames);
+        for (uint32_t i = 0; i < Count; ++i) OneByOneSum += Expected[i].Type + Expected[i].Length;
+    }
+    auto OneByOneNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count();
+
+    uint64_t ScanSum = 0;
+    Start = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < Iterations; ++n) {
+        uint32_t Count = ScanAllFrames(Data.data(), Length, Scanned, MaxFrames, 8);
+        for (uint32_t i = 0; i < Count; ++i) ScanSum += Scanned[i].Type + Scanned[i].Length;
+    }
+    auto ScanNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count();
+
+    VERIFY(OneByOneSum == ScanSum);
+    printf("    %u byte buffer, %u frames: one by one %.1f ns/buffer, scan %.1f ns/buffer\n",
+        Length, ExpectedCount, OneByOneNs / Iterations, ScanNs / Iterations);
+    return true;
+}
+
+// Sends RequestCount small (HEADERS + DATA + FIN) responses, either gathered in
+// one send call or as the separate headers and data sends apps used before.
+bool SmallResponses(bool Gathered, uint32_t RequestCount) {
+    MsH3Api Api; VERIFY(Api.IsValid());
+    TestServer Server(Api); VERIFY(Server.IsValid());
+    TestClient Client(Api); VERIFY(Client.IsValid());
+    VERIFY_SUCCESS(Client.Start());
+    VERIFY(Server.WaitForConnection());
+    VERIFY(Client.Connected.WaitFor());
+    auto ServerConnection = Server.NewConnection.Get();
+
+    QUIC_STATISTICS_V2 StatsStart = {0}, StatsEnd = {0};
+    uint32_t BufferLength = sizeof(StatsStart);
+    VERIFY_SUCCESS(MsH3ConnectionGetQuicParam(ServerConnection->Handle, QUIC_PARAM_CONN_STATISTICS_V2, &BufferLength, &StatsStart));
+    auto CpuStart = std::clock();
+    auto TimeStart = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < RequestCount; ++i) {
+        Server.NewRequest.Reset();
+        TestRequest Request(Client);
+        VERIFY(Request.Send(RequestHeaders, RequestHeadersCount, nullptr, 0, MSH3_REQUEST_SEND_FLAG_FIN));
+        VERIFY(Server.NewRequest.WaitFor());
+        auto ServerRequest = Server.NewRequest.Get();
+        if (Gathered) {
+            VERIFY(ServerRequest->Send(ResponseHeaders, ResponseHeadersCount, ResponseData, sizeof(ResponseData), MSH3_REQUEST_SEND_FLAG_FIN));
+        } else {
+            VERIFY(ServerRequest->Send(ResponseHeaders, ResponseHeadersCount, nullptr, 0));
+            VERIFY(ServerRequest->Send(nullptr, 0, ResponseData, sizeof(ResponseData), MSH3_REQUEST_SEND_FLAG_FIN));
+        }
+        VERIFY(Request.AllDataReceived.WaitFor());
+        VERIFY(Request.TotalDataReceived == sizeof(ResponseData));
+    }
+
+    auto CpuUs = (double)(std::clock() - CpuStart) * 1000000.0 / CLOCKS_PER_SEC;
+    auto TimeUs = (double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - TimeStart).count();
+    BufferLength = sizeof(StatsEnd);
+    VERIFY_SUCCESS(MsH3ConnectionGetQuicParam(ServerConnection->Handle, QUIC_PARAM_CONN_STATISTICS_V2, &BufferLength, &StatsEnd));
+
+    printf("    %s, %u requests: %.1f us/request, %.1f us CPU/request, %.2f server packets/request\n",
+        Gathered ? "one send" : "two sends", RequestCount, TimeUs / RequestCount, CpuUs / RequestCount,
+        (double)(StatsEnd.SendTotalPackets - StatsStart.SendTotalPackets) / RequestCount);
+    fflush(stdout);
+
+    Client.Shutdown();
+    VERIFY(Client.ShutdownComplete.WaitFor());
+    return true;
+}
+
+DEF_TEST(SmallResponseBenchmark) {
+    // Compares gathered HEADERS + DATA + FIN responses against the two send path
+    return SmallResponses(false, 100) && SmallResponses(true, 100);
+}
+
 const TestFunc TestFunctions[] = {
     ADD_TEST(Handshake),
     //ADD_TEST(HandshakeSingleThread),
@@ -1046,6 +2760,7 @@ const TestFunc TestFunctions[] = {
     ADD_TEST(DifferentResponseCodes),
     ADD_TEST(MultipleRequests),
     ADD_TEST(GetQuicParamBasic),
+    ADD_TEST(PoolStatistics),
     ADD_TEST(ConnectionGetQuicParam),
     ADD_TEST(RequestGetQuicParam),
     ADD_TEST(RequestDownload1MB),
@@ -1056,6 +2771,50 @@ const TestFunc TestFunctions[] = {
     ADD_TEST(RequestUpload50MB),
     ADD_TEST(RequestBidirectional10MB),
     ADD_TEST(DynamicQPackSettings),
+    ADD_TEST(SendVectored),
+    ADD_TEST(SendDeclaredBodyLength),
+    ADD_TEST(HeaderTemplate),
+    ADD_TEST(SharedBufferFanOut),
+    ADD_TEST(SendFile),
+    ADD_TEST(ReceiveFile),
+    ADD_TEST(ReceiveFileUpload),
+    ADD_TEST(SendBuffered),
+    ADD_TEST(SendCoalesced),
+    ADD_TEST(SendCompleteBatch),
+    ADD_TEST(SendBackpressure),
+    ADD_TEST(SendLargeHeaders),
+    ADD_TEST(SendLargeHeadersDynamic),
+    ADD_TEST(SendLargeHeaderValue),
+    ADD_TEST(ReceiveLargeHeader),
+    ADD_TEST(ReceiveLargeHeaderDynamic),
+    ADD_TEST(ReceiveHeaderOverMaxFieldSection),
+    ADD_TEST(ConcurrentRequestSend),
+    ADD_TEST(SubmitBatch),
+    ADD_TEST(SubmitBatchLastFails),
+    ADD_TEST(ReceiveAsyncResumable),
+    ADD_TEST(ReceiveAsyncTrailers),
+    ADD_TEST(ReceiveAsyncTrailersClose),
+    ADD_TEST(ReceiveVectored),
+    ADD_TEST(ReceiveVectoredAsync),
+    ADD_TEST(ReceiveRetained),
+    ADD_TEST(HeadersComplete),
+    ADD_TEST(HeadersCompleteDynamic),
+    ADD_TEST(HeadersCompleteArenaFull),
+    ADD_TEST(PseudoHeaders),
+    ADD_TEST(ContentLengthHint),
+    ADD_TEST(ContentLengthHeadRequest),
+    ADD_TEST(ContentLengthHeadTemplate),
+    ADD_TEST(ContentLengthHeadBatch),
+    ADD_TEST(ContentLengthTooShort),
+    ADD_TEST(ContentLengthTooLong),
+    ADD_TEST(ContentLengthInvalid),
+    ADD_TEST(FrameReaderByteByByte),
+    ADD_TEST(FrameReaderSplitAnywhere),
+    ADD_TEST(FrameReaderSkipUnknown),
+    ADD_TEST(FrameReaderTooBig),
+    ADD_TEST(FrameScanner),
+    ADD_TEST(FrameScanBenchmark),
+    ADD_TEST(SmallResponseBenchmark),
 };
 const uint32_t TestCount = sizeof(TestFunctions)/sizeof(TestFunc);
 